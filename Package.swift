@@ -11,7 +11,7 @@ let package = Package(
         .target(
             name: "llama",
             path: ".",
-            sources: ["ggml.c", "llama.cpp"],
+            sources: ["ggml.c", "ggml-kernels.c", "llama.cpp"],
             publicHeadersPath: "spm-headers",
             cSettings: [.unsafeFlags(["-Wno-shorten-64-to-32"])]
         ),
@@ -19,7 +19,6 @@ import os
 import sys
 import json
 import struct
-import numpy as np
 import torch
 
 from sentencepiece import SentencePieceProcessor
@@ -28,7 +27,7 @@ def parse_args():
 
     parser = argparse.ArgumentParser(description='Convert a LLaMA model checkpoint to a ggml compatible file')
     parser.add_argument('dir_model',  help='directory containing the model checkpoint')
-    parser.add_argument('ftype',      help='file type (0: float32, 1: float16)', type=int, choices=[0, 1], default=1)
+    parser.add_argument('ftype',      help='file type (0: float32, 1: float16, 7: bfloat16)', type=int, choices=[0, 1, 7], default=1)
     parser.add_argument('vocab_only', help='only write vocab to file', type=int, default=0, nargs='?')
     return parser.parse_args()
 
@@ -106,15 +105,21 @@ def process_and_write_variables(fout, model, ftype):
 
         print(f"Processing variable: {name} with shape: {shape} and type: {datao.dtype}")
 
-        data = datao.numpy().squeeze()
         n_dims = len(shape)
 
         # default type is fp16
         ftype_cur = 1
         if ftype == 0 or n_dims == 1:
             print("  Converting to float32")
-            data = data.astype(np.float32)
+            data = datao.float().numpy().squeeze()
             ftype_cur = 0
+        elif ftype == 7:
+            # numpy has no bfloat16, write the upper halves of the float32 values, rounded to nearest even
+            print("  Converting to bfloat16")
+            data = datao.to(torch.bfloat16).view(torch.int16).numpy().squeeze()
+            ftype_cur = 7
+        else:
+            data = datao.half().numpy().squeeze()
 
         # header
         sname = name.encode('utf-8')
@@ -131,7 +136,7 @@ def main():
     args = parse_args()
     dir_model = args.dir_model
     ftype = args.ftype
-    ftype_str = ["f32", "f16"]
+    ftype_str = {0: "f32", 1: "f16", 7: "bf16"}
 
     hparams, tokenizer = load_hparams_and_tokenizer(dir_model)
 
@@ -133,10 +133,38 @@ bool gpt_params_parse(int argc, char ** argv, gpt_params & params) {
                 break;
             }
             params.model = argv[i];
+        } else if (arg == "-md" || arg == "--model-draft") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            params.model_draft = argv[i];
+        } else if (arg == "--draft") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            params.n_draft = std::stoi(argv[i]);
         } else if (arg == "-i" || arg == "--interactive") {
             params.interactive = true;
         } else if (arg == "--embedding") {
             params.embedding = true;
+        } else if (arg == "--pooling") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            std::string value = argv[i];
+            if (value == "last") {
+                params.pooling = 0;
+            } else if (value == "mean") {
+                params.pooling = 1;
+            } else if (value == "max") {
+                params.pooling = 2;
+            } else {
+                invalid_param = true;
+                break;
+            }
         } else if (arg == "--interactive-start") {
             params.interactive = true;
         } else if (arg == "--interactive-first") {
@@ -147,6 +175,14 @@ bool gpt_params_parse(int argc, char ** argv, gpt_params & params) {
             params.use_color = true;
         } else if (arg == "--mlock") {
             params.use_mlock = true;
+        } else if (arg == "--numa") {
+            params.numa = true;
+        } else if (arg == "--cpus") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            params.cpus = argv[i];
         } else if (arg == "--mtest") {
             params.mem_test = true;
         } else if (arg == "--verbose-prompt") {
@@ -167,6 +203,12 @@ bool gpt_params_parse(int argc, char ** argv, gpt_params & params) {
                 break;
             }
             params.n_parts = std::stoi(argv[i]);
+        } else if (arg == "--n_parts_draft") {
+            if (++i >= argc) {
+                invalid_param = true;
+                break;
+            }
+            params.n_parts_draft = std::stoi(argv[i]);
         } else if (arg == "-h" || arg == "--help") {
             gpt_print_usage(argc, argv, params);
             exit(0);
@@ -225,14 +267,23 @@ void gpt_print_usage(int /*argc*/, char ** argv, const gpt_params & params) {
     fprintf(stderr, "  --n_parts N           number of model parts (default: -1 = determine from dimensions)\n");
     fprintf(stderr, "  -b N, --batch_size N  batch size for prompt processing (default: %d)\n", params.n_batch);
     fprintf(stderr, "  --perplexity          compute perplexity over the prompt\n");
+    fprintf(stderr, "  --pooling {last,mean,max}\n");
+    fprintf(stderr, "                        pooling of the token embeddings in embedding mode (default: last)\n");
     fprintf(stderr, "  --keep                number of tokens to keep from the initial prompt (default: %d, -1 = all)\n", params.n_keep);
     if (ggml_mlock_supported()) {
         fprintf(stderr, "  --mlock               force system to keep model in RAM rather than swapping or compressing\n");
     }
+    fprintf(stderr, "  --numa                spread the compute threads and the weights over the NUMA nodes\n");
+    fprintf(stderr, "  --cpus SET            pin the compute threads to a cpu list (e.g. 0-7,16) or to a policy:\n");
+    fprintf(stderr, "                        physical (one cpu per core), l2 (one cpu per L2 cache), numa:N (cpus of node N)\n");
     fprintf(stderr, "  --mtest               compute maximum memory usage\n");
     fprintf(stderr, "  --verbose-prompt      print prompt before generation\n");
     fprintf(stderr, "  -m FNAME, --model FNAME\n");
     fprintf(stderr, "                        model path (default: %s)\n", params.model.c_str());
+    fprintf(stderr, "  -md FNAME, --model-draft FNAME\n");
+    fprintf(stderr, "                        draft model for speculative decoding (default: none)\n");
+    fprintf(stderr, "  --draft N             number of tokens to draft per step for speculative decoding (default: %d)\n", params.n_draft);
+    fprintf(stderr, "  --n_parts_draft N     number of draft model parts (default: -1 = determine from dimensions)\n");
     fprintf(stderr, "\n");
 }
 
@@ -19,9 +19,12 @@ struct gpt_params {
     int32_t n_predict     = 128;  // new tokens to predict
     int32_t repeat_last_n = 64;   // last n tokens to penalize
     int32_t n_parts       = -1;   // amount of model parts (-1 = determine from model dimensions)
+    int32_t n_parts_draft = -1;   // amount of draft model parts (-1 = determine from model dimensions)
     int32_t n_ctx         = 512;  // context size
     int32_t n_batch       = 8;    // batch size for prompt processing
     int32_t n_keep        = 0;    // number of tokens to keep from initial prompt
+    int32_t n_draft       = 4;    // number of tokens to draft per step (speculative decoding)
+    int32_t pooling       = 0;    // embedding pooling (0 = last token, 1 = mean, 2 = max)
 
     // sampling parameters
     int32_t top_k = 40;
@@ -30,8 +33,10 @@ struct gpt_params {
     float   repeat_penalty  = 1.10f;
 
     std::string model  = "models/lamma-7B/ggml-model.bin"; // model path
+    std::string model_draft = "";  // draft model path (speculative decoding)
     std::string prompt = "";
     std::string input_prefix = ""; // string to prefix user inputs with
+    std::string cpus = "";         // cpus to pin the compute threads to (see ggml_cpu_select())
 
 
     std::vector<std::string> antiprompt; // string upon seeing which more user input is prompted
@@ -48,6 +53,7 @@ struct gpt_params {
     bool ignore_eos        = false; // do not stop generating after eos
     bool perplexity        = false; // compute perplexity over the prompt
     bool use_mlock         = false; // use mlock to keep model in memory
+    bool numa              = false; // spread the threads and the weights over the NUMA nodes
     bool mem_test          = false; // compute maximum memory usage
     bool verbose_prompt    = false; // print prompt tokens before generation
 };
@@ -39,7 +39,10 @@ int main(int argc, char ** argv) {
         lparams.f16_kv     = params.memory_f16;
         lparams.logits_all = params.perplexity;
         lparams.use_mlock  = params.use_mlock;
+        lparams.numa       = params.numa;
+        lparams.cpus       = params.cpus.empty() ? NULL : params.cpus.c_str();
         lparams.embedding  = params.embedding;
+        lparams.pooling    = (llama_pooling_type) params.pooling;
 
         ctx = llama_init_from_file(params.model.c_str(), lparams);
 
@@ -56,42 +59,105 @@ int main(int argc, char ** argv) {
                 params.n_threads, std::thread::hardware_concurrency(), llama_print_system_info());
     }
 
-    int n_past = 0;
+    // every line of the prompt is a separate input
+    std::vector<std::string> inputs;
+    {
+        size_t start = 0;
+        while (start <= params.prompt.size()) {
+            size_t end = params.prompt.find('\n', start);
+            if (end == std::string::npos) {
+                end = params.prompt.size();
+            }
+            if (end > start || inputs.empty()) {
+                inputs.push_back(params.prompt.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+    }
 
-    // Add a space in front of the first character to match OG llama tokenizer behavior
-    params.prompt.insert(0, 1, ' ');
+    // tokenize the inputs
+    std::vector<std::vector<llama_token>> inputs_tok;
+    for (auto & input : inputs) {
+        // Add a space in front of the first character to match OG llama tokenizer behavior
+        input.insert(0, 1, ' ');
 
-    // tokenize the prompt
-    auto embd_inp = ::llama_tokenize(ctx, params.prompt, true);
+        inputs_tok.push_back(::llama_tokenize(ctx, input, true));
 
-    // determine newline token
-    auto llama_token_newline = ::llama_tokenize(ctx, "\n", false);
+        if ((int) inputs_tok.back().size() > params.n_ctx) {
+            fprintf(stderr, "%s: error: input is too long (%d tokens, max %d)\n", __func__, (int) inputs_tok.back().size(), params.n_ctx);
+            return 1;
+        }
+    }
 
     if (params.verbose_prompt) {
-        fprintf(stderr, "\n");
-        fprintf(stderr, "%s: prompt: '%s'\n", __func__, params.prompt.c_str());
-        fprintf(stderr, "%s: number of tokens in prompt = %zu\n", __func__, embd_inp.size());
-        for (int i = 0; i < (int) embd_inp.size(); i++) {
-            fprintf(stderr, "%6d -> '%s'\n", embd_inp[i], llama_token_to_str(ctx, embd_inp[i]));
+        for (size_t k = 0; k < inputs.size(); k++) {
+            fprintf(stderr, "\n");
+            fprintf(stderr, "%s: prompt: '%s'\n", __func__, inputs[k].c_str());
+            fprintf(stderr, "%s: number of tokens in prompt = %zu\n", __func__, inputs_tok[k].size());
+            for (int i = 0; i < (int) inputs_tok[k].size(); i++) {
+                fprintf(stderr, "%6d -> '%s'\n", inputs_tok[k][i], llama_token_to_str(ctx, inputs_tok[k][i]));
+            }
         }
         fprintf(stderr, "\n");
     }
 
     if (params.embedding){
-        if (embd_inp.size() > 0) {
-            if (llama_eval(ctx, embd_inp.data(), embd_inp.size(), n_past, params.n_threads)) {
-                fprintf(stderr, "%s : failed to eval\n", __func__);
+        const int n_embd = llama_n_embd(ctx);
+
+        const size_t n_batch = std::min(params.n_batch, params.n_ctx);
+
+        // pack as many inputs as fit in a batch of n_batch tokens, each one as its own sequence
+        // every token attends over all the cells of the batch, so packing more inputs grows the cost quadratically
+        // an input longer than n_batch is evaluated alone, in batches of n_batch tokens that extend its pooling
+        size_t k0 = 0;
+        while (k0 < inputs_tok.size()) {
+            size_t n_tokens = inputs_tok[k0].size();
+
+            size_t k1 = k0 + 1;
+            while (k1 < inputs_tok.size() && n_tokens + inputs_tok[k1].size() <= n_batch) {
+                n_tokens += inputs_tok[k1].size();
+                k1++;
+            }
+
+            std::vector<llama_token> tokens;
+            std::vector<int> pos;
+            std::vector<int> seq_id;
+
+            for (size_t k = k0; k < k1; k++) {
+                for (size_t i = 0; i < inputs_tok[k].size(); i++) {
+                    tokens.push_back(inputs_tok[k][i]);
+                    pos.push_back(i);
+                    seq_id.push_back(k - k0);
+                }
+            }
+
+            if (llama_kv_cache_seq_rm(ctx, -1, 0)) {
+                fprintf(stderr, "%s : failed to clear the KV cache\n", __func__);
                 return 1;
             }
-        }
 
-        const int n_embd = llama_n_embd(ctx);
-        const auto embeddings = llama_get_embeddings(ctx);
+            for (size_t i0 = 0; i0 < tokens.size(); i0 += n_batch) {
+                const int n_eval = (int) std::min(tokens.size() - i0, n_batch);
+
+                llama_batch batch = { n_eval, tokens.data() + i0, pos.data() + i0, seq_id.data() + i0, NULL };
+
+                if (llama_decode(ctx, batch, params.n_threads)) {
+                    fprintf(stderr, "%s : failed to eval\n", __func__);
+                    return 1;
+                }
+            }
+
+            for (size_t k = k0; k < k1; k++) {
+                const float * embeddings = llama_get_embeddings_seq(ctx, k - k0);
+
+                for (int i = 0; i < n_embd; i++) {
+                    printf("%f ", embeddings ? embeddings[i] : 0.0f);
+                }
+                printf("\n");
+            }
 
-        for (int i = 0; i < n_embd; i++) {
-            printf("%f ", embeddings[i]);
+            k0 = k1;
         }
-        printf("\n");
     }
 
     llama_print_timings(ctx);
@@ -98,6 +98,8 @@ int main(int argc, char ** argv) {
         lparams.seed       = params.seed;
         lparams.f16_kv     = params.memory_f16;
         lparams.use_mlock  = params.use_mlock;
+        lparams.numa       = params.numa;
+        lparams.cpus       = params.cpus.empty() ? NULL : params.cpus.c_str();
 
         ctx = llama_init_from_file(params.model.c_str(), lparams);
 
@@ -88,6 +88,14 @@ int main(int argc, char ** argv) {
 
     params.perplexity = true;
 
+    if (params.embedding) {
+        printf("\n************\n");
+        printf("%s: please use the 'embedding' tool for embedding calculations\n", __func__);
+        printf("************\n\n");
+
+        return 0;
+    }
+
     if (params.n_ctx > 2048) {
         fprintf(stderr, "%s: warning: model does not support context sizes greater than 2048 tokens (%d specified);"
                 "expect poor results\n", __func__, params.n_ctx);
@@ -116,7 +124,8 @@ int main(int argc, char ** argv) {
         lparams.f16_kv     = params.memory_f16;
         lparams.logits_all = params.perplexity;
         lparams.use_mlock  = params.use_mlock;
-        lparams.embedding  = params.embedding;
+        lparams.numa       = params.numa;
+        lparams.cpus       = params.cpus.empty() ? NULL : params.cpus.c_str();
 
         ctx = llama_init_from_file(params.model.c_str(), lparams);
 
@@ -0,0 +1,160 @@
+#include "common.h"
+#include "llama.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char ** argv) {
+    gpt_params params;
+    params.model = "models/llama-30B/ggml-model.bin";
+
+    if (gpt_params_parse(argc, argv, params) == false) {
+        return 1;
+    }
+
+    if (params.model_draft.empty()) {
+        fprintf(stderr, "%s: error: a draft model is required (--model-draft)\n", __func__);
+        return 1;
+    }
+
+    if (params.seed <= 0) {
+        params.seed = time(NULL);
+    }
+
+    fprintf(stderr, "%s: seed = %d\n", __func__, params.seed);
+
+    std::mt19937 rng(params.seed);
+    if (params.random_prompt) {
+        params.prompt = gpt_random_prompt(rng);
+    }
+
+    llama_context * ctx_tgt;
+    llama_context * ctx_dft;
+
+    // load the target and the draft models
+    {
+        auto lparams = llama_context_default_params();
+
+        lparams.n_ctx      = params.n_ctx;
+        lparams.n_parts    = params.n_parts;
+        lparams.seed       = params.seed;
+        lparams.f16_kv     = params.memory_f16;
+        lparams.use_mlock  = params.use_mlock;
+        lparams.numa       = params.numa;
+        lparams.cpus       = params.cpus.empty() ? NULL : params.cpus.c_str();
+
+        ctx_tgt = llama_init_from_file(params.model.c_str(), lparams);
+        if (ctx_tgt == NULL) {
+            fprintf(stderr, "%s: error: failed to load model '%s'\n", __func__, params.model.c_str());
+            return 1;
+        }
+
+        lparams.n_parts = params.n_parts_draft;
+
+        ctx_dft = llama_init_from_file(params.model_draft.c_str(), lparams);
+        if (ctx_dft == NULL) {
+            fprintf(stderr, "%s: error: failed to load draft model '%s'\n", __func__, params.model_draft.c_str());
+            return 1;
+        }
+    }
+
+    // print system information
+    {
+        fprintf(stderr, "\n");
+        fprintf(stderr, "system_info: n_threads = %d / %d | %s\n",
+                params.n_threads, std::thread::hardware_concurrency(), llama_print_system_info());
+    }
+
+    // Add a space in front of the first character to match OG llama tokenizer behavior
+    params.prompt.insert(0, 1, ' ');
+
+    // tokenize the prompt
+    auto embd_inp = ::llama_tokenize(ctx_tgt, params.prompt, true);
+
+    if ((int) embd_inp.size() > params.n_ctx - 4) {
+        fprintf(stderr, "%s: error: prompt is too long (%d tokens, max %d)\n", __func__, (int) embd_inp.size(), params.n_ctx - 4);
+        return 1;
+    }
+
+    for (auto id : embd_inp) {
+        printf("%s", llama_token_to_str(ctx_tgt, id));
+    }
+    fflush(stdout);
+
+    // evaluate the prompt on both models, except for the last token which starts the first step
+    const int n_prompt = embd_inp.size();
+
+    for (int i = 0; i < n_prompt - 1; i += params.n_batch) {
+        const int n_eval = std::min(n_prompt - 1 - i, params.n_batch);
+
+        if (llama_eval_logits(ctx_tgt, &embd_inp[i], n_eval, i, params.n_threads, NULL) ||
+            llama_eval_logits(ctx_dft, &embd_inp[i], n_eval, i, params.n_threads, NULL)) {
+            fprintf(stderr, "%s : failed to eval\n", __func__);
+            return 1;
+        }
+    }
+
+    std::vector<llama_token> last_n_tokens(params.repeat_last_n, 0);
+    for (auto id : embd_inp) {
+        last_n_tokens.erase(last_n_tokens.begin());
+        last_n_tokens.push_back(id);
+    }
+
+    auto sparams = llama_speculative_default_params();
+
+    sparams.n_draft        = params.n_draft;
+    sparams.top_k          = params.top_k;
+    sparams.top_p          = params.top_p;
+    sparams.temp           = params.temp;
+    sparams.repeat_penalty = params.repeat_penalty;
+
+    std::vector<llama_token> out(params.n_draft + 1);
+
+    int n_past    = n_prompt - 1;
+    int n_predict = 0;
+
+    llama_token id = embd_inp.back();
+
+    bool is_done = false;
+    while (!is_done && n_predict < params.n_predict && n_past + params.n_draft + 2 < params.n_ctx) {
+        const int n_out = llama_speculative_step(ctx_tgt, ctx_dft,
+                last_n_tokens.data(), last_n_tokens.size(), id, n_past, sparams, out.data(), params.n_threads);
+
+        if (n_out < 0) {
+            fprintf(stderr, "%s : failed to eval\n", __func__);
+            return 1;
+        }
+
+        for (int i = 0; i < n_out && !is_done; ++i) {
+            if (out[i] == llama_token_eos() && !params.ignore_eos) {
+                fprintf(stderr, " [end of text]\n");
+                is_done = true;
+                break;
+            }
+
+            printf("%s", llama_token_to_str(ctx_tgt, out[i]));
+
+            last_n_tokens.erase(last_n_tokens.begin());
+            last_n_tokens.push_back(out[i]);
+
+            is_done = ++n_predict >= params.n_predict;
+        }
+        fflush(stdout);
+
+        n_past += n_out;
+        id      = out[n_out - 1];
+    }
+
+    printf("\n");
+
+    fprintf(stderr, "\n%s: acceptance rate = %.2f %%\n", __func__, 100.0f*llama_speculative_acceptance_rate(ctx_tgt));
+
+    llama_print_timings(ctx_dft);
+    llama_print_timings(ctx_tgt);
+
+    llama_free(ctx_dft);
+    llama_free(ctx_tgt);
+
+    return 0;
+}
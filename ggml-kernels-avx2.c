@@ -0,0 +1,8 @@
+// the kernels built for AVX2, see ggml-kernels.c
+
+#if !defined(__AVX2__)
+#error "ggml-kernels-avx2.c must be compiled with the AVX2 flags"
+#endif
+
+#define GGML_KERNELS_VARIANT avx2
+#include "ggml-kernels.c"
@@ -0,0 +1,8 @@
+// the kernels built for AVX512, see ggml-kernels.c
+
+#if !(defined(__AVX512F__) && defined(__AVX512BW__))
+#error "ggml-kernels-avx512.c must be compiled with the AVX512 flags"
+#endif
+
+#define GGML_KERNELS_VARIANT avx512
+#include "ggml-kernels.c"
@@ -0,0 +1,8 @@
+// the kernels built for AVX512-BF16, see ggml-kernels.c
+
+#if !(defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VNNI__) && defined(__AVX512BF16__))
+#error "ggml-kernels-avx512_bf16.c must be compiled with the AVX512-BF16 flags"
+#endif
+
+#define GGML_KERNELS_VARIANT avx512_bf16
+#include "ggml-kernels.c"
@@ -0,0 +1,8 @@
+// the kernels built for AVX512-VNNI, see ggml-kernels.c
+
+#if !(defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VNNI__))
+#error "ggml-kernels-avx512_vnni.c must be compiled with the AVX512-VNNI flags"
+#endif
+
+#define GGML_KERNELS_VARIANT avx512_vnni
+#include "ggml-kernels.c"
@@ -0,0 +1,8 @@
+// the kernels built for AVX-VNNI, see ggml-kernels.c
+
+#if !(defined(__AVX2__) && defined(__AVXVNNI__))
+#error "ggml-kernels-avx_vnni.c must be compiled with the AVX-VNNI flags"
+#endif
+
+#define GGML_KERNELS_VARIANT avx_vnni
+#include "ggml-kernels.c"
@@ -0,0 +1,2341 @@
+// compute kernels: quantize_row_q*, dequantize_row_q*, the quantized dot products and gemm tiles, the fp16 row
+// conversions, the f32 and f16 dot products and the packed sgemm micro-kernel, see ggml-kernels.h
+//
+// this file is compiled once with the flags of the build into ggml_kernels_base. with GGML_DISPATCH, the
+// ggml-kernels-<name>.c wrappers compile it again with the flags of an x86 instruction set into ggml_kernels_<name>
+
+#include "ggml-kernels.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GGML_KERNELS_VARIANT
+#define GGML_KERNELS_VARIANT base
+#endif
+
+// __FMA__ and __F16C__ are not defined in MSVC, however they are implied with AVX2/AVX512
+#if defined(_MSC_VER) && (defined(__AVX2__) || defined(__AVX512F__))
+#ifndef __FMA__
+#define __FMA__
+#endif
+#ifndef __F16C__
+#define __F16C__
+#endif
+#ifndef __SSE3__
+#define __SSE3__
+#endif
+#endif
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__POWER9_VECTOR__)
+#include <altivec.h>
+#undef bool
+#define bool _Bool
+#else
+#include <immintrin.h>
+#endif
+
+#undef MIN
+#undef MAX
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define GGML_PAD(x, n) (((x) + (n) - 1) & ~((n) - 1))
+
+// 16-bit float conversions used by ggml-simd.h
+#if defined(__ARM_NEON)
+#define GGML_FP16_TO_FP32(x) ((float) (x))
+#define GGML_FP32_TO_FP16(x) (x)
+#elif defined(__F16C__)
+#ifdef _MSC_VER
+#define GGML_FP16_TO_FP32(x) _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(x)))
+#define GGML_FP32_TO_FP16(x) _mm_extract_epi16(_mm_cvtps_ph(_mm_set_ss(x), 0), 0)
+#else
+#define GGML_FP16_TO_FP32(x) _cvtsh_ss(x)
+#define GGML_FP32_TO_FP16(x) _cvtss_sh(x, 0)
+#endif
+#else
+#define GGML_FP16_TO_FP32(x) ggml_fp16_to_fp32(x)
+#define GGML_FP32_TO_FP16(x) ggml_fp32_to_fp16(x)
+#endif
+
+#include "ggml-simd.h"
+
+#define GGML_KERNELS_TABLE_(variant) ggml_kernels_ ## variant
+#define GGML_KERNELS_TABLE(variant) GGML_KERNELS_TABLE_(variant)
+
+// AVX routines provided by GH user Const-me
+// ref: https://github.com/ggerganov/ggml/pull/27#issuecomment-1464934600
+#if __AVX2__ || __AVX512F__
+// Unpack 32 4-bit fields into 32 bytes
+// The output vector contains 32 bytes, each one in [ 0 .. 15 ] interval
+static inline __m256i bytesFromNibbles( const uint8_t* rsi )
+{
+    // Load 16 bytes from memory
+    __m128i tmp = _mm_loadu_si128( ( const __m128i* )rsi );
+
+    // Expand bytes into uint16_t values
+    __m256i bytes = _mm256_cvtepu8_epi16( tmp );
+
+    // Unpack values into individual bytes
+    const __m256i lowMask = _mm256_set1_epi8( 0xF );
+    __m256i high = _mm256_andnot_si256( lowMask, bytes );
+    __m256i low = _mm256_and_si256( lowMask, bytes );
+    high = _mm256_slli_epi16( high, 4 );
+    bytes = _mm256_or_si256( low, high );
+    return bytes;
+}
+
+// Expand 32 bits into 32 bytes, each one 0xFF if its bit is set and 0x00 otherwise
+static inline __m256i bytesFromBits( const uint8_t* rsi )
+{
+    uint32_t x32;
+    memcpy( &x32, rsi, sizeof( uint32_t ) );
+
+    // Broadcast byte j of x32 to the bytes 8*j .. 8*j + 7
+    const __m256i shuf_mask = _mm256_set_epi64x( 0x0303030303030303, 0x0202020202020202, 0x0101010101010101, 0x0000000000000000 );
+    __m256i bytes = _mm256_shuffle_epi8( _mm256_set1_epi32( x32 ), shuf_mask );
+
+    // Set all the bits but bit (l % 8) of byte l, the bytes with their bit set become 0xFF
+    const __m256i bit_mask = _mm256_set1_epi64x( 0x7fbfdfeff7fbfdfe );
+    bytes = _mm256_or_si256( bytes, bit_mask );
+    return _mm256_cmpeq_epi8( bytes, _mm256_set1_epi64x( -1 ) );
+}
+
+static inline __m128i packNibbles( __m256i bytes )
+{
+    // Move bits within 16-bit lanes from 0000_abcd_0000_efgh into 0000_0000_abcd_efgh
+    const __m256i lowByte = _mm256_set1_epi16( 0xFF );
+    __m256i high = _mm256_andnot_si256( lowByte, bytes );
+    __m256i low = _mm256_and_si256( lowByte, bytes );
+    high = _mm256_srli_epi16( high, 4 );
+    bytes = _mm256_or_si256( low, high );
+
+    // Compress uint16_t lanes into bytes
+    __m128i r0 = _mm256_castsi256_si128( bytes );
+    __m128i r1 = _mm256_extracti128_si256( bytes, 1 );
+    return _mm_packus_epi16( r0, r1 );
+}
+#endif
+
+// reference implementation for deterministic creation of model files
+static void quantize_row_q4_0_reference(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q4_0 * restrict y = vy;
+
+    uint8_t pp[QK/2];
+
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        for (int l = 0; l < QK; l++) {
+            const float v = x[i*QK + l];
+            amax = MAX(amax, fabsf(v));
+        }
+
+        const float d = amax / ((1 << 3) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].d = d;
+
+        for (int l = 0; l < QK; l += 2) {
+            const float v0 = x[i*QK + l + 0]*id;
+            const float v1 = x[i*QK + l + 1]*id;
+
+            const uint8_t vi0 = (int8_t)roundf(v0) + 8;
+            const uint8_t vi1 = (int8_t)roundf(v1) + 8;
+
+            assert(vi0 >= 0 && vi0 < 16);
+            assert(vi1 >= 0 && vi1 < 16);
+
+            pp[l/2] = vi0 | (vi1 << 4);
+        }
+
+        memcpy(y[i].qs, pp, sizeof(pp));
+    }
+}
+
+static void quantize_row_q4_0(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q4_0 * restrict y = vy;
+
+#if defined(__POWER9_VECTOR__)
+    const vector float v85 = vec_splats(8.5f);
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        vector float srcv [8];
+        vector float asrcv[8];
+        vector float amaxv[8];
+
+        for (int l = 0; l < 8; l++) srcv[l]  = *(vector float *)(x + i*32 + 4*l);
+        for (int l = 0; l < 8; l++) asrcv[l] = vec_abs(srcv[l]);
+
+        for (int l = 0; l < 4; l++) amaxv[2*l] = vec_max(asrcv[2*l], asrcv[2*l+1]);
+        //for (int l = 0; l < 2; l++) amaxv[4*l] = vec_max(amaxv[4*l], amaxv[4*l+2]);
+        amaxv[0] = vec_max(amaxv[0], amaxv[2]);
+        amaxv[4] = vec_max(amaxv[4], amaxv[6]);
+        //for (int l = 0; l < 1; l++) amaxv[8*l] = vec_max(amaxv[8*l], amaxv[8*l+4]);
+        amaxv[0] = vec_max(amaxv[0], amaxv[4]);
+
+        amax = MAX(
+                MAX(vec_extract(amaxv[0], 0), vec_extract(amaxv[0], 1)),
+                MAX(vec_extract(amaxv[0], 2), vec_extract(amaxv[0], 3)));
+
+        const float d = amax / ((1 << 3) - 1);
+        const float id = d ? 1.0/d : 0.0;
+
+        y[i].d = d;
+
+        const vector float vid = vec_splats(id);
+        uint8_t * restrict pb = y[i].qs;
+        for (int l = 0; l < 8; l++) {
+            const vector float vf  = vec_madd(srcv[l], vid, v85);
+            const vector signed int vi = vec_signed(vf);
+
+            pb[2*l + 0] = vec_extract(vi, 0) | (vec_extract(vi, 1) << 4);
+            pb[2*l + 1] = vec_extract(vi, 2) | (vec_extract(vi, 3) << 4);
+        }
+    }
+#elif __ARM_NEON
+    uint8_t pp[QK/2];
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        float32x4_t srcv [8];
+        float32x4_t asrcv[8];
+        float32x4_t amaxv[8];
+
+        for (int l = 0; l < 8; l++) srcv[l]  = vld1q_f32(x + i*32 + 4*l);
+        for (int l = 0; l < 8; l++) asrcv[l] = vabsq_f32(srcv[l]);
+
+        for (int l = 0; l < 4; l++) amaxv[2*l] = vmaxq_f32(asrcv[2*l], asrcv[2*l+1]);
+        for (int l = 0; l < 2; l++) amaxv[4*l] = vmaxq_f32(amaxv[4*l], amaxv[4*l+2]);
+        for (int l = 0; l < 1; l++) amaxv[8*l] = vmaxq_f32(amaxv[8*l], amaxv[8*l+4]);
+
+        amax = MAX(
+                MAX(vgetq_lane_f32(amaxv[0], 0), vgetq_lane_f32(amaxv[0], 1)),
+                MAX(vgetq_lane_f32(amaxv[0], 2), vgetq_lane_f32(amaxv[0], 3)));
+
+        const float d = amax / ((1 << 3) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].d = d;
+
+        for (int l = 0; l < 8; l++) {
+            const float32x4_t v  = vmulq_n_f32(srcv[l], id);
+            const float32x4_t vf = vaddq_f32(v, vdupq_n_f32(8.5f));
+            const int32x4_t   vi = vcvtq_s32_f32(vf);
+
+            pp[2*l + 0] = vgetq_lane_s32(vi, 0) | (vgetq_lane_s32(vi, 1) << 4);
+            pp[2*l + 1] = vgetq_lane_s32(vi, 2) | (vgetq_lane_s32(vi, 3) << 4);
+        }
+
+        memcpy(y[i].qs, pp, sizeof(pp));
+    }
+#elif defined(__AVX2__)
+    for (int i = 0; i < nb; i++) {
+        // Load elements into 4 AVX vectors
+        __m256 v0 = _mm256_loadu_ps( x );
+        __m256 v1 = _mm256_loadu_ps( x + 8 );
+        __m256 v2 = _mm256_loadu_ps( x + 16 );
+        __m256 v3 = _mm256_loadu_ps( x + 24 );
+        x += 32;
+
+        // Compute max(abs(e)) for the block
+        const __m256 signBit = _mm256_set1_ps( -0.0f );
+        __m256 maxAbs = _mm256_andnot_ps( signBit, v0 );
+        maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v1 ) );
+        maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v2 ) );
+        maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v3 ) );
+
+        __m128 max4 = _mm_max_ps( _mm256_extractf128_ps( maxAbs, 1 ), _mm256_castps256_ps128( maxAbs ) );
+        max4 = _mm_max_ps( max4, _mm_movehl_ps( max4, max4 ) );
+        max4 = _mm_max_ss( max4, _mm_movehdup_ps( max4 ) );
+        const float maxScalar = _mm_cvtss_f32( max4 );
+
+        // Quantize these floats
+        const float d = maxScalar / 7.0f;
+        y[i].d = d;
+        const float id = ( maxScalar != 0.0f ) ? 7.0f / maxScalar : 0.0f;
+        const __m256 mul = _mm256_set1_ps( id );
+
+        // Apply the multiplier
+        v0 = _mm256_mul_ps( v0, mul );
+        v1 = _mm256_mul_ps( v1, mul );
+        v2 = _mm256_mul_ps( v2, mul );
+        v3 = _mm256_mul_ps( v3, mul );
+
+        // Round to nearest integer
+        v0 = _mm256_round_ps( v0, _MM_ROUND_NEAREST );
+        v1 = _mm256_round_ps( v1, _MM_ROUND_NEAREST );
+        v2 = _mm256_round_ps( v2, _MM_ROUND_NEAREST );
+        v3 = _mm256_round_ps( v3, _MM_ROUND_NEAREST );
+
+        // Convert floats to integers
+        __m256i i0 = _mm256_cvtps_epi32( v0 );
+        __m256i i1 = _mm256_cvtps_epi32( v1 );
+        __m256i i2 = _mm256_cvtps_epi32( v2 );
+        __m256i i3 = _mm256_cvtps_epi32( v3 );
+
+        // Convert int32 to int16
+        i0 = _mm256_packs_epi32( i0, i1 );	// 0, 1, 2, 3,  8, 9, 10, 11,  4, 5, 6, 7, 12, 13, 14, 15
+        i2 = _mm256_packs_epi32( i2, i3 );	// 16, 17, 18, 19,  24, 25, 26, 27,  20, 21, 22, 23, 28, 29, 30, 31
+                                            // Convert int16 to int8
+        i0 = _mm256_packs_epi16( i0, i2 );	// 0, 1, 2, 3,  8, 9, 10, 11,  16, 17, 18, 19,  24, 25, 26, 27,  4, 5, 6, 7, 12, 13, 14, 15, 20, 21, 22, 23, 28, 29, 30, 31
+
+        // We got our precious signed bytes, but the order is now wrong
+        // These AVX2 pack instructions process 16-byte pieces independently
+        // The following instruction is fixing the order
+        const __m256i perm = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+        i0 = _mm256_permutevar8x32_epi32( i0, perm );
+
+        // Apply offset to translate the range from [ -7 .. +7 ] into [ +1 .. +15 ]
+        const __m256i off = _mm256_set1_epi8( 8 );
+        i0 = _mm256_add_epi8( i0, off );
+
+        // Compress the vector into 4 bit/value, and store
+        __m128i res = packNibbles( i0 );
+        _mm_storeu_si128( ( __m128i* )y[i].qs, res );
+    }
+#elif defined(__wasm_simd128__)
+    uint8_t pp[QK/2];
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        v128_t srcv [8];
+        v128_t asrcv[8];
+        v128_t amaxv[8];
+
+        for (int l = 0; l < 8; l++) srcv[l]  = wasm_v128_load(x + i*32 + 4*l);
+        for (int l = 0; l < 8; l++) asrcv[l] = wasm_f32x4_abs(srcv[l]);
+
+        for (int l = 0; l < 4; l++) amaxv[2*l] = wasm_f32x4_max(asrcv[2*l], asrcv[2*l+1]);
+        for (int l = 0; l < 2; l++) amaxv[4*l] = wasm_f32x4_max(amaxv[4*l], amaxv[4*l+2]);
+        for (int l = 0; l < 1; l++) amaxv[8*l] = wasm_f32x4_max(amaxv[8*l], amaxv[8*l+4]);
+
+        amax = MAX(
+                MAX(wasm_f32x4_extract_lane(amaxv[0], 0), wasm_f32x4_extract_lane(amaxv[0], 1)),
+                MAX(wasm_f32x4_extract_lane(amaxv[0], 2), wasm_f32x4_extract_lane(amaxv[0], 3)));
+
+        const float d = amax / ((1 << 3) - 1);
+        const float id = d ? 1.0/d : 0.0;
+
+        y[i].d = d;
+
+        for (int l = 0; l < 8; l++) {
+            const v128_t v  = wasm_f32x4_mul(srcv[l], wasm_f32x4_splat(id));
+            const v128_t vf = wasm_f32x4_add(v, wasm_f32x4_splat(8.5f));
+            const v128_t vi = wasm_i32x4_trunc_sat_f32x4(vf);
+
+            pp[2*l + 0] = wasm_i32x4_extract_lane(vi, 0) | (wasm_i32x4_extract_lane(vi, 1) << 4);
+            pp[2*l + 1] = wasm_i32x4_extract_lane(vi, 2) | (wasm_i32x4_extract_lane(vi, 3) << 4);
+        }
+
+        memcpy(y[i].qs, pp, sizeof(pp));
+    }
+#else
+    // scalar
+    (void) nb;
+    quantize_row_q4_0_reference(x, y, k);
+#endif
+}
+
+static void quantize_row_q4_1_reference(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q4_1 * restrict y = vy;
+
+    uint8_t pp[QK/2];
+
+    for (int i = 0; i < nb; i++) {
+        float min = FLT_MAX;
+        float max = -FLT_MAX;
+
+        for (int l = 0; l < QK; l++) {
+            const float v = x[i*QK + l];
+            if (v < min) min = v;
+            if (v > max) max = v;
+        }
+
+        const float d = (max - min) / ((1 << 4) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].d = d;
+        y[i].m = min;
+
+        for (int l = 0; l < QK; l += 2) {
+            const float v0 = (x[i*QK + l + 0] - min)*id;
+            const float v1 = (x[i*QK + l + 1] - min)*id;
+
+            const uint8_t vi0 = roundf(v0);
+            const uint8_t vi1 = roundf(v1);
+
+            assert(vi0 >= 0 && vi0 < 16);
+            assert(vi1 >= 0 && vi1 < 16);
+
+            pp[l/2] = vi0 | (vi1 << 4);
+        }
+
+        memcpy(y[i].qs, pp, sizeof(pp));
+    }
+}
+
+static void quantize_row_q4_1(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+
+#if defined(__AVX2__)
+    const int nb = k / QK;
+
+    block_q4_1 * restrict y = vy;
+
+    for (int i = 0; i < nb; i++) {
+        // Load elements into 4 AVX vectors
+        __m256 v0 = _mm256_loadu_ps( x );
+        __m256 v1 = _mm256_loadu_ps( x + 8 );
+        __m256 v2 = _mm256_loadu_ps( x + 16 );
+        __m256 v3 = _mm256_loadu_ps( x + 24 );
+        x += 32;
+
+        // Compute max for the block
+        __m256 vmax;
+        vmax = _mm256_max_ps( v0, v1 );
+        vmax = _mm256_max_ps( vmax, v2 );
+        vmax = _mm256_max_ps( vmax, v3 );
+
+        __m128 max4 = _mm_max_ps( _mm256_extractf128_ps( vmax, 1 ), _mm256_castps256_ps128( vmax ) );
+        max4 = _mm_max_ps( max4, _mm_movehl_ps( max4, max4 ) );
+        max4 = _mm_max_ss( max4, _mm_movehdup_ps( max4 ) );
+        const float maxScalar = _mm_cvtss_f32( max4 );
+
+        // Compute min for the block
+        __m256 vmin;
+        vmin = _mm256_min_ps( v0, v1 );
+        vmin = _mm256_min_ps( vmin, v2 );
+        vmin = _mm256_min_ps( vmin, v3 );
+
+        __m128 min4 = _mm_min_ps( _mm256_extractf128_ps( vmin, 1 ), _mm256_castps256_ps128( vmin ) );
+        min4 = _mm_min_ps( min4, _mm_movehl_ps( min4, min4 ) );
+        min4 = _mm_min_ss( min4, _mm_movehdup_ps( min4 ) );
+        const float minScalar = _mm_cvtss_f32( min4 );
+
+        // Quantize these floats
+        const float d = (maxScalar - minScalar) / ((1 << 4) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].m = minScalar;
+        y[i].d = d;
+
+        // x = (x-min)*id
+        const __m256 mul = _mm256_set1_ps( id );
+        const __m256 off = _mm256_set1_ps( minScalar );
+        v0 = _mm256_mul_ps( _mm256_sub_ps( v0, off ), mul );
+        v1 = _mm256_mul_ps( _mm256_sub_ps( v1, off ), mul );
+        v2 = _mm256_mul_ps( _mm256_sub_ps( v2, off ), mul );
+        v3 = _mm256_mul_ps( _mm256_sub_ps( v3, off ), mul );
+
+        // Round to nearest integer
+        v0 = _mm256_round_ps( v0, _MM_ROUND_NEAREST );
+        v1 = _mm256_round_ps( v1, _MM_ROUND_NEAREST );
+        v2 = _mm256_round_ps( v2, _MM_ROUND_NEAREST );
+        v3 = _mm256_round_ps( v3, _MM_ROUND_NEAREST );
+
+        // Convert floats to integers
+        __m256i i0 = _mm256_cvtps_epi32( v0 );
+        __m256i i1 = _mm256_cvtps_epi32( v1 );
+        __m256i i2 = _mm256_cvtps_epi32( v2 );
+        __m256i i3 = _mm256_cvtps_epi32( v3 );
+
+        // Convert int32 to int16
+        i0 = _mm256_packs_epi32( i0, i1 );	// 0, 1, 2, 3,  8, 9, 10, 11,  4, 5, 6, 7, 12, 13, 14, 15
+        i2 = _mm256_packs_epi32( i2, i3 );	// 16, 17, 18, 19,  24, 25, 26, 27,  20, 21, 22, 23, 28, 29, 30, 31
+                                            // Convert int16 to int8
+        i0 = _mm256_packs_epi16( i0, i2 );	// 0, 1, 2, 3,  8, 9, 10, 11,  16, 17, 18, 19,  24, 25, 26, 27,  4, 5, 6, 7, 12, 13, 14, 15, 20, 21, 22, 23, 28, 29, 30, 31
+
+        // We got our precious signed bytes, but the order is now wrong
+        // These AVX2 pack instructions process 16-byte pieces independently
+        // The following instruction is fixing the order
+        const __m256i perm = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+        i0 = _mm256_permutevar8x32_epi32( i0, perm );
+
+        // Compress the vector into 4 bit/value, and store
+        __m128i res = packNibbles( i0 );
+        _mm_storeu_si128( ( __m128i* )y[i].qs, res );
+    }
+#else
+    // scalar
+    quantize_row_q4_1_reference(x, vy, k);
+#endif
+}
+
+static void dequantize_row_q4_0(const void * restrict vx, float * restrict y, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    const block_q4_0 * restrict x = vx;
+
+#if defined(__AVX2__)
+    for (int i = 0; i < nb; i++) {
+        // scale factor
+        const __m256 d_v = _mm256_broadcast_ss(&x[i].d);
+
+        const uint8_t * restrict pp = x[i].qs;
+
+        for (int l = 0; l < QK; l += 32) {
+            // Load 32x4-bit integers into 32x8-bit integers
+            __m256i vx8 = bytesFromNibbles(pp+l/2);
+
+            // Subtract 8 from the integers
+            vx8 = _mm256_sub_epi8(vx8, _mm256_set1_epi8(8));
+
+            // Convert to 16-bit int
+            const __m256i vx16_lo = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vx8, 0));
+            const __m256i vx16_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vx8, 1));
+
+            // Convert to 32-bit int -> float 32
+            const __m256 vf[4] = {
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_lo, 0))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_lo, 1))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_hi, 0))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_hi, 1)))
+            };
+
+            // Scale and store
+            for (int j = 0; j < 4; j++) {
+                const __m256 result = _mm256_mul_ps(vf[j], d_v);
+                _mm256_storeu_ps(y + i * QK + l + j*8, result);
+            }
+        }
+    }
+#elif defined(__ARM_NEON)
+    for (int i = 0; i < nb; i++) {
+        const float32x4_t vd = vdupq_n_f32(x[i].d);
+
+        const uint8_t * restrict pp = x[i].qs;
+
+        for (int l = 0; l < QK; l += 16) {
+            // Load 16x4-bit integers into 8x8-bit integers
+            const uint8x8_t v8 = vld1_u8(pp + l/2);
+
+            // Expand 4-bit qs to 8-bit bytes
+            const uint8x8_t v0 = vand_u8(v8, vdup_n_u8(0x0f));
+            const uint8x8_t v1 = vshr_n_u8(v8, 4);
+
+            // Convert to signed 8-bit integers
+            const int8x8_t vs_0 = vreinterpret_s8_u8(v0);
+            const int8x8_t vs_1 = vreinterpret_s8_u8(v1);
+
+            // Subtract 8 from each byte
+            const int8x8_t vb_0 = vsub_s8(vs_0, vdup_n_s8(8));
+            const int8x8_t vb_1 = vsub_s8(vs_1, vdup_n_s8(8));
+
+            // Interleave and combine
+            const int8x8_t vx_0 = vzip1_s8(vb_0, vb_1);
+            const int8x8_t vx_1 = vzip2_s8(vb_0, vb_1);
+
+            const int8x16_t vq = vcombine_s8(vx_0, vx_1);
+
+            // convert to 2x int16x8_t
+            const int16x8_t vi_0 = vmovl_s8(vget_low_s8 (vq));
+            const int16x8_t vi_1 = vmovl_s8(vget_high_s8(vq));
+
+            // convert to 4x float32x4_t
+            const float32x4_t vf_0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16 (vi_0)));
+            const float32x4_t vf_1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vi_0)));
+            const float32x4_t vf_2 = vcvtq_f32_s32(vmovl_s16(vget_low_s16 (vi_1)));
+            const float32x4_t vf_3 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vi_1)));
+
+            // Multiply by d
+            const float32x4_t r0 = vmulq_f32(vf_0, vd);
+            const float32x4_t r1 = vmulq_f32(vf_1, vd);
+            const float32x4_t r2 = vmulq_f32(vf_2, vd);
+            const float32x4_t r3 = vmulq_f32(vf_3, vd);
+
+            // Store
+            vst1q_f32(y + i*QK + l +  0, r0);
+            vst1q_f32(y + i*QK + l +  4, r1);
+            vst1q_f32(y + i*QK + l +  8, r2);
+            vst1q_f32(y + i*QK + l + 12, r3);
+        }
+    }
+#else
+    // scalar
+    for (int i = 0; i < nb; i++) {
+        const float d = x[i].d;
+
+        const uint8_t * restrict pp = x[i].qs;
+
+        for (int l = 0; l < QK; l += 2) {
+            const uint8_t vi = pp[l/2];
+
+            const int8_t vi0 = vi & 0xf;
+            const int8_t vi1 = vi >> 4;
+
+            const float v0 = (vi0 - 8)*d;
+            const float v1 = (vi1 - 8)*d;
+
+            //printf("d = %f, vi = %d, vi0 = %d, vi1 = %d, v0 = %f, v1 = %f\n", d, vi, vi0, vi1, v0, v1);
+
+            y[i*QK + l + 0] = v0;
+            y[i*QK + l + 1] = v1;
+
+            assert(!isnan(y[i*QK + l + 0]));
+            assert(!isnan(y[i*QK + l + 1]));
+        }
+    }
+#endif
+}
+
+static void dequantize_row_q4_1(const void * restrict vx, float * restrict y, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    const block_q4_1 * restrict x = vx;
+
+#if defined(__AVX2__)
+    for (int i = 0; i < nb; i++) {
+        const __m256 d_v = _mm256_broadcast_ss(&x[i].d);
+        const __m256 d_m = _mm256_broadcast_ss(&x[i].m);
+
+        const uint8_t * restrict pp = x[i].qs;
+
+        for (int l = 0; l < QK; l += 32) {
+            // Load 32x4-bit integers into 32x8-bit integers
+            __m256i vx8 = bytesFromNibbles(pp+l/2);
+
+            // Convert to 16-bit int
+            const __m256i vx16_lo = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vx8, 0));
+            const __m256i vx16_hi = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(vx8, 1));
+
+            // Convert to 32-bit int -> float 32
+            const __m256 vf[4] = {
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_lo, 0))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_lo, 1))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_hi, 0))),
+                _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(vx16_hi, 1)))
+            };
+
+            // Scale, add m and store
+            for (int j = 0; j < 4; j++) {
+                const __m256 result = _mm256_add_ps(_mm256_mul_ps(vf[j], d_v), d_m);
+                _mm256_storeu_ps(y + i * QK + l + j*8, result);
+            }
+        }
+    }
+#else
+    for (int i = 0; i < nb; i++) {
+        const float d = x[i].d;
+        const float m = x[i].m;
+
+        const uint8_t * restrict pp = x[i].qs;
+
+        for (int l = 0; l < QK; l += 2) {
+            const uint8_t vi = pp[l/2];
+
+            const int8_t vi0 = vi & 0xf;
+            const int8_t vi1 = vi >> 4;
+
+            const float v0 = vi0*d + m;
+            const float v1 = vi1*d + m;
+
+            y[i*QK + l + 0] = v0;
+            y[i*QK + l + 1] = v1;
+
+            assert(!isnan(y[i*QK + l + 0]));
+            assert(!isnan(y[i*QK + l + 1]));
+        }
+    }
+#endif
+}
+
+static void quantize_row_q8_0_reference(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q8_0 * restrict y = vy;
+
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        for (int l = 0; l < QK; l++) {
+            const float v = x[i*QK + l];
+            amax = MAX(amax, fabsf(v));
+        }
+
+        const float d = amax / ((1 << 7) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].d = d;
+
+        for (int l = 0; l < QK; l++) {
+            y[i].qs[l] = roundf(x[i*QK + l]*id);
+        }
+    }
+}
+
+static void quantize_row_q8_1_reference(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q8_1 * restrict y = vy;
+
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+
+        for (int l = 0; l < QK; l++) {
+            const float v = x[i*QK + l];
+            amax = MAX(amax, fabsf(v));
+        }
+
+        const float d = amax / ((1 << 7) - 1);
+        const float id = d ? 1.0f/d : 0.0f;
+
+        int sum = 0;
+
+        for (int l = 0; l < QK; l++) {
+            y[i].qs[l] = roundf(x[i*QK + l]*id);
+            sum += y[i].qs[l];
+        }
+
+        y[i].d = d;
+        y[i].s = d*sum;
+    }
+}
+
+#if defined(__AVX2__)
+// quantize one block of QK floats to 8 bits, returns the delta and stores the quants in qs
+// the sum of the quants is returned in *sum when it is not NULL
+static inline float quantize_block_q8_avx2(const float * restrict x, int8_t * restrict qs, int * restrict sum) {
+    // Load elements into 4 AVX vectors
+    __m256 v0 = _mm256_loadu_ps( x );
+    __m256 v1 = _mm256_loadu_ps( x + 8 );
+    __m256 v2 = _mm256_loadu_ps( x + 16 );
+    __m256 v3 = _mm256_loadu_ps( x + 24 );
+
+    // Compute max(abs(e)) for the block
+    const __m256 signBit = _mm256_set1_ps( -0.0f );
+    __m256 maxAbs = _mm256_andnot_ps( signBit, v0 );
+    maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v1 ) );
+    maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v2 ) );
+    maxAbs = _mm256_max_ps( maxAbs, _mm256_andnot_ps( signBit, v3 ) );
+
+    __m128 max4 = _mm_max_ps( _mm256_extractf128_ps( maxAbs, 1 ), _mm256_castps256_ps128( maxAbs ) );
+    max4 = _mm_max_ps( max4, _mm_movehl_ps( max4, max4 ) );
+    max4 = _mm_max_ss( max4, _mm_movehdup_ps( max4 ) );
+    const float maxScalar = _mm_cvtss_f32( max4 );
+
+    // Quantize these floats
+    const float d = maxScalar / ((1 << 7) - 1);
+    const float id = d ? 1.0f/d : 0.0f;
+
+    const __m256 mul = _mm256_set1_ps( id );
+    v0 = _mm256_mul_ps( v0, mul );
+    v1 = _mm256_mul_ps( v1, mul );
+    v2 = _mm256_mul_ps( v2, mul );
+    v3 = _mm256_mul_ps( v3, mul );
+
+    // Round to nearest integer
+    v0 = _mm256_round_ps( v0, _MM_ROUND_NEAREST );
+    v1 = _mm256_round_ps( v1, _MM_ROUND_NEAREST );
+    v2 = _mm256_round_ps( v2, _MM_ROUND_NEAREST );
+    v3 = _mm256_round_ps( v3, _MM_ROUND_NEAREST );
+
+    // Convert floats to integers
+    __m256i i0 = _mm256_cvtps_epi32( v0 );
+    __m256i i1 = _mm256_cvtps_epi32( v1 );
+    __m256i i2 = _mm256_cvtps_epi32( v2 );
+    __m256i i3 = _mm256_cvtps_epi32( v3 );
+
+    if (sum) {
+        // Sum of the quants, the order does not matter here
+        __m256i s = _mm256_add_epi32( _mm256_add_epi32( i0, i1 ), _mm256_add_epi32( i2, i3 ) );
+        __m128i s4 = _mm_add_epi32( _mm256_extracti128_si256( s, 1 ), _mm256_castsi256_si128( s ) );
+        s4 = _mm_add_epi32( s4, _mm_unpackhi_epi64( s4, s4 ) );
+        s4 = _mm_add_epi32( s4, _mm_shuffle_epi32( s4, 1 ) );
+        *sum = _mm_cvtsi128_si32( s4 );
+    }
+
+    // Convert int32 to int16
+    i0 = _mm256_packs_epi32( i0, i1 );	// 0, 1, 2, 3,  8, 9, 10, 11,  4, 5, 6, 7, 12, 13, 14, 15
+    i2 = _mm256_packs_epi32( i2, i3 );	// 16, 17, 18, 19,  24, 25, 26, 27,  20, 21, 22, 23, 28, 29, 30, 31
+                                        // Convert int16 to int8
+    i0 = _mm256_packs_epi16( i0, i2 );	// 0, 1, 2, 3,  8, 9, 10, 11,  16, 17, 18, 19,  24, 25, 26, 27,  4, 5, 6, 7, 12, 13, 14, 15, 20, 21, 22, 23, 28, 29, 30, 31
+
+    // We got our precious signed bytes, but the order is now wrong
+    // These AVX2 pack instructions process 16-byte pieces independently
+    // The following instruction is fixing the order
+    const __m256i perm = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+    i0 = _mm256_permutevar8x32_epi32( i0, perm );
+
+    _mm256_storeu_si256( ( __m256i* )qs, i0 );
+
+    return d;
+}
+#endif
+
+static void quantize_row_q8_0(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+
+    block_q8_0 * restrict y = vy;
+
+#if defined(__AVX2__)
+    const int nb = k / QK;
+
+    for (int i = 0; i < nb; i++) {
+        y[i].d = quantize_block_q8_avx2(x + i*QK, y[i].qs, NULL);
+    }
+#else
+    // scalar
+    quantize_row_q8_0_reference(x, y, k);
+#endif
+}
+
+static void quantize_row_q8_1(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+
+    block_q8_1 * restrict y = vy;
+
+#if defined(__AVX2__)
+    const int nb = k / QK;
+
+    for (int i = 0; i < nb; i++) {
+        int sum;
+        const float d = quantize_block_q8_avx2(x + i*QK, y[i].qs, &sum);
+
+        y[i].d = d;
+        y[i].s = d*sum;
+    }
+#else
+    // scalar
+    quantize_row_q8_1_reference(x, y, k);
+#endif
+}
+
+static void quantize_row_q5_0_reference(const float * restrict x, void * restrict vy, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    block_q5_0 * restrict y = vy;
+
+    for (int i = 0; i < nb; i++) {
+        float amax = 0.0f; // absolute max
+        float max  = 0.0f; // the value with the absolute max, with its sign
+
+        for (int l = 0; l < QK; l++) {
+            const float v = x[i*QK + l];
+            if (amax < fabsf(v)) {
+                amax = fabsf(v);
+                max  = v;
+            }
+        }
+
+        // map max to -16, so that the whole [ -16 .. +15 ] range is used
+        const float d = max / -((1 << 4));
+        const float id = d ? 1.0f/d : 0.0f;
+
+        y[i].d = d;
+
+        uint32_t qh = 0;
+
+        for (int l = 0; l < QK; l += 2) {
+            const float v0 = x[i*QK + l + 0]*id;
+            const float v1 = x[i*QK + l + 1]*id;
+
+            const uint8_t vi0 = MIN(31, (int8_t) (v0 + 16.5f));
+            const uint8_t vi1 = MIN(31, (int8_t) (v1 + 16.5f));
+
+            y[i].qs[l/2] = (vi0 & 0xF) | ((vi1 & 0xF) << 4);
+
+            qh |= ((uint32_t) (vi0 >> 4) << (l + 0));
+            qh |= ((uint32_t) (vi1 >> 4) << (l + 1));
+        }
+
+        memcpy(y[i].qh, &qh, sizeof(qh));
+    }
+}
+
+static void quantize_row_q5_0(const float * restrict x, void * restrict vy, int k) {
+    quantize_row_q5_0_reference(x, vy, k);
+}
+
+static void dequantize_row_q5_0(const void * restrict vx, float * restrict y, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    const block_q5_0 * restrict x = vx;
+
+    for (int i = 0; i < nb; i++) {
+        const float d = x[i].d;
+
+        uint32_t qh;
+        memcpy(&qh, x[i].qh, sizeof(qh));
+
+        for (int l = 0; l < QK; l += 2) {
+            const uint8_t vi = x[i].qs[l/2];
+
+            const int8_t vi0 = ((vi & 0xF) | (((qh >> (l + 0)) & 1) << 4)) - 16;
+            const int8_t vi1 = ((vi >>  4) | (((qh >> (l + 1)) & 1) << 4)) - 16;
+
+            y[i*QK + l + 0] = vi0*d;
+            y[i*QK + l + 1] = vi1*d;
+        }
+    }
+}
+
+static void dequantize_row_q8_0(const void * restrict vx, float * restrict y, int k) {
+    assert(k % QK == 0);
+    const int nb = k / QK;
+
+    const block_q8_0 * restrict x = vx;
+
+    for (int i = 0; i < nb; i++) {
+        const float d = x[i].d;
+
+        for (int l = 0; l < QK; l++) {
+            y[i*QK + l] = x[i].qs[l]*d;
+        }
+    }
+}
+
+// q4_0 weights times q4_0 activations, used by the targets without a q4_0 x q8_0 kernel
+#if defined(__ARM_NEON) || defined(__wasm_simd128__)
+static void ggml_vec_dot_q4_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+    assert(nb % 2 == 0);
+
+    const block_q4_0 * restrict x = vx;
+    const block_q4_0 * restrict y = vy;
+
+    ggml_float sumf = 0.0;
+
+#if defined(__ARM_NEON)
+    float sum0 = 0.0f;
+    float sum1 = 0.0f;
+
+    for (int i = 0; i < nb; i += 2) {
+        const block_q4_0 * restrict x0 = &x[i + 0];
+        const block_q4_0 * restrict y0 = &y[i + 0];
+        const block_q4_0 * restrict x1 = &x[i + 1];
+        const block_q4_0 * restrict y1 = &y[i + 1];
+
+        const uint8x16_t m4b = vdupq_n_u8(0xf);
+        const int8x16_t  s8b = vdupq_n_s8(0x8);
+
+        const uint8x16_t v0_0 = vld1q_u8(x0->qs);
+        const uint8x16_t v1_0 = vld1q_u8(y0->qs);
+        const uint8x16_t v0_1 = vld1q_u8(x1->qs);
+        const uint8x16_t v1_1 = vld1q_u8(y1->qs);
+
+        // 4-bit -> 8-bit
+        const int8x16_t v0_0l = vreinterpretq_s8_u8(vandq_u8(v0_0, m4b));
+        const int8x16_t v1_0l = vreinterpretq_s8_u8(vandq_u8(v1_0, m4b));
+
+        const int8x16_t v0_0h = vreinterpretq_s8_u8(vshrq_n_u8(v0_0, 4));
+        const int8x16_t v1_0h = vreinterpretq_s8_u8(vshrq_n_u8(v1_0, 4));
+
+        const int8x16_t v0_1l = vreinterpretq_s8_u8(vandq_u8(v0_1, m4b));
+        const int8x16_t v1_1l = vreinterpretq_s8_u8(vandq_u8(v1_1, m4b));
+
+        const int8x16_t v0_1h = vreinterpretq_s8_u8(vshrq_n_u8(v0_1, 4));
+        const int8x16_t v1_1h = vreinterpretq_s8_u8(vshrq_n_u8(v1_1, 4));
+
+        // sub 8
+        const int8x16_t v0_0ls = vsubq_s8(v0_0l, s8b);
+        const int8x16_t v1_0ls = vsubq_s8(v1_0l, s8b);
+
+        const int8x16_t v0_0hs = vsubq_s8(v0_0h, s8b);
+        const int8x16_t v1_0hs = vsubq_s8(v1_0h, s8b);
+
+        const int8x16_t v0_1ls = vsubq_s8(v0_1l, s8b);
+        const int8x16_t v1_1ls = vsubq_s8(v1_1l, s8b);
+
+        const int8x16_t v0_1hs = vsubq_s8(v0_1h, s8b);
+        const int8x16_t v1_1hs = vsubq_s8(v1_1h, s8b);
+
+#if defined(__ARM_FEATURE_DOTPROD)
+        // dot product into int16x8_t
+        int32x4_t p_0 = vdotq_s32(vdupq_n_s32(0), v0_0ls, v1_0ls);
+        int32x4_t p_1 = vdotq_s32(vdupq_n_s32(0), v0_1ls, v1_1ls);
+
+        p_0 = vdotq_s32(p_0, v0_0hs, v1_0hs);
+        p_1 = vdotq_s32(p_1, v0_1hs, v1_1hs);
+
+        // scalar
+#if defined(__ARM_FEATURE_QRDMX)
+        sum0 += x0->d * y0->d * vaddvq_s32(p_0);
+        sum1 += x1->d * y1->d * vaddvq_s32(p_1);
+#else
+        sum0 += x0->d * y0->d * (vgetq_lane_s32(p_0, 0) + vgetq_lane_s32(p_0, 1) + vgetq_lane_s32(p_0, 2) + vgetq_lane_s32(p_0, 3));
+        sum1 += x1->d * y1->d * (vgetq_lane_s32(p_1, 0) + vgetq_lane_s32(p_1, 1) + vgetq_lane_s32(p_1, 2) + vgetq_lane_s32(p_1, 3));
+#endif
+#else
+	    const int16x8_t pl0l = vmull_s8(vget_low_s8 (v0_0ls), vget_low_s8 (v1_0ls));
+        const int16x8_t pl0h = vmull_s8(vget_high_s8(v0_0ls), vget_high_s8(v1_0ls));
+
+        const int16x8_t ph0l = vmull_s8(vget_low_s8 (v0_0hs), vget_low_s8 (v1_0hs));
+        const int16x8_t ph0h = vmull_s8(vget_high_s8(v0_0hs), vget_high_s8(v1_0hs));
+
+        const int16x8_t pl1l = vmull_s8(vget_low_s8 (v0_1ls), vget_low_s8 (v1_1ls));
+        const int16x8_t pl1h = vmull_s8(vget_high_s8(v0_1ls), vget_high_s8(v1_1ls));
+
+        const int16x8_t ph1l = vmull_s8(vget_low_s8 (v0_1hs), vget_low_s8 (v1_1hs));
+        const int16x8_t ph1h = vmull_s8(vget_high_s8(v0_1hs), vget_high_s8(v1_1hs));
+
+        const int16x8_t pl_0 = vaddq_s16(pl0l, pl0h);
+        const int16x8_t ph_0 = vaddq_s16(ph0l, ph0h);
+
+        const int16x8_t pl_1 = vaddq_s16(pl1l, pl1h);
+        const int16x8_t ph_1 = vaddq_s16(ph1l, ph1h);
+
+        const int16x8_t p_0 = vaddq_s16(pl_0, ph_0);
+        const int16x8_t p_1 = vaddq_s16(pl_1, ph_1);
+
+        // scalar
+#if defined(__ARM_FEATURE_QRDMX)
+        sum0 += x0->d * y0->d * vaddvq_s16(p_0);
+        sum1 += x1->d * y1->d * vaddvq_s16(p_1);
+#else
+        sum0 += x0->d * y0->d * (vgetq_lane_s16(p_0, 0) + vgetq_lane_s16(p_0, 1) + vgetq_lane_s16(p_0, 2) + vgetq_lane_s16(p_0, 3) + vgetq_lane_s16(p_0, 4) + vgetq_lane_s16(p_0, 5) + vgetq_lane_s16(p_0, 6) + vgetq_lane_s16(p_0, 7));
+        sum1 += x1->d * y1->d * (vgetq_lane_s16(p_1, 0) + vgetq_lane_s16(p_1, 1) + vgetq_lane_s16(p_1, 2) + vgetq_lane_s16(p_1, 3) + vgetq_lane_s16(p_1, 4) + vgetq_lane_s16(p_1, 5) + vgetq_lane_s16(p_1, 6) + vgetq_lane_s16(p_1, 7));
+#endif
+#endif
+    }
+
+    sumf = (ggml_float)(sum0 + sum1);
+#elif defined(__wasm_simd128__)
+    // wasm simd
+    float sum0 = 0.0f;
+    float sum1 = 0.0f;
+
+    for (int i = 0; i < nb; i += 2) {
+        const block_q4_0 * restrict x0 = &px[i + 0];
+        const block_q4_0 * restrict y0 = &py[i + 0];
+        const block_q4_0 * restrict x1 = &px[i + 1];
+        const block_q4_0 * restrict y1 = &py[i + 1];
+
+        const v128_t m4b = wasm_u8x16_splat(0xf);
+        const v128_t s8b = wasm_i8x16_splat(0x8);
+
+        const v128_t v0_0 = wasm_v128_load(x0.qs);
+        const v128_t v0_1 = wasm_v128_load(y0.qs);
+        const v128_t v1_0 = wasm_v128_load(x1.qs);
+        const v128_t v1_1 = wasm_v128_load(y1.qs);
+
+        // 4-bit -> 8-bit
+        const v128_t v0_0l = wasm_v128_and(v0_0, m4b);
+        const v128_t v1_0l = wasm_v128_and(v1_0, m4b);
+
+        const v128_t v0_0h = wasm_u8x16_shr(v0_0, 4);
+        const v128_t v1_0h = wasm_u8x16_shr(v1_0, 4);
+
+        const v128_t v0_1l = wasm_v128_and(v0_1, m4b);
+        const v128_t v1_1l = wasm_v128_and(v1_1, m4b);
+
+        const v128_t v0_1h = wasm_u8x16_shr(v0_1, 4);
+        const v128_t v1_1h = wasm_u8x16_shr(v1_1, 4);
+
+        // sub 8
+        const v128_t v0_0ls = wasm_i8x16_sub(v0_0l, s8b);
+        const v128_t v1_0ls = wasm_i8x16_sub(v1_0l, s8b);
+
+        const v128_t v0_0hs = wasm_i8x16_sub(v0_0h, s8b);
+        const v128_t v1_0hs = wasm_i8x16_sub(v1_0h, s8b);
+
+        const v128_t v0_1ls = wasm_i8x16_sub(v0_1l, s8b);
+        const v128_t v1_1ls = wasm_i8x16_sub(v1_1l, s8b);
+
+        const v128_t v0_1hs = wasm_i8x16_sub(v0_1h, s8b);
+        const v128_t v1_1hs = wasm_i8x16_sub(v1_1h, s8b);
+
+        // dot product into int16x8_t
+        const v128_t pl0l = wasm_i16x8_mul(wasm_i16x8_extend_low_i8x16(v0_0ls), wasm_i16x8_extend_low_i8x16(v1_0ls));
+        const v128_t pl0h = wasm_i16x8_mul(wasm_i16x8_extend_high_i8x16(v0_0ls), wasm_i16x8_extend_high_i8x16(v1_0ls));
+
+        const v128_t ph0l = wasm_i16x8_mul(wasm_i16x8_extend_low_i8x16(v0_0hs), wasm_i16x8_extend_low_i8x16(v1_0hs));
+        const v128_t ph0h = wasm_i16x8_mul(wasm_i16x8_extend_high_i8x16(v0_0hs), wasm_i16x8_extend_high_i8x16(v1_0hs));
+
+        const v128_t pl1l = wasm_i16x8_mul(wasm_i16x8_extend_low_i8x16(v0_1ls), wasm_i16x8_extend_low_i8x16(v1_1ls));
+        const v128_t pl1h = wasm_i16x8_mul(wasm_i16x8_extend_high_i8x16(v0_1ls), wasm_i16x8_extend_high_i8x16(v1_1ls));
+
+        const v128_t ph1l = wasm_i16x8_mul(wasm_i16x8_extend_low_i8x16(v0_1hs), wasm_i16x8_extend_low_i8x16(v1_1hs));
+        const v128_t ph1h = wasm_i16x8_mul(wasm_i16x8_extend_high_i8x16(v0_1hs), wasm_i16x8_extend_high_i8x16(v1_1hs));
+
+        const v128_t pl_0 = wasm_i16x8_add(pl0l, pl0h);
+        const v128_t ph_0 = wasm_i16x8_add(ph0l, ph0h);
+
+        const v128_t pl_1 = wasm_i16x8_add(pl1l, pl1h);
+        const v128_t ph_1 = wasm_i16x8_add(ph1l, ph1h);
+
+        const v128_t p_0 = wasm_i16x8_add(pl_0, ph_0);
+        const v128_t p_1 = wasm_i16x8_add(pl_1, ph_1);
+
+        sum0 += x0->d * y0->d * (
+                wasm_i16x8_extract_lane(p_0, 0) + wasm_i16x8_extract_lane(p_0, 1) +
+                wasm_i16x8_extract_lane(p_0, 2) + wasm_i16x8_extract_lane(p_0, 3) +
+                wasm_i16x8_extract_lane(p_0, 4) + wasm_i16x8_extract_lane(p_0, 5) +
+                wasm_i16x8_extract_lane(p_0, 6) + wasm_i16x8_extract_lane(p_0, 7));
+        sum1 += x1->d * y1->d * (
+                wasm_i16x8_extract_lane(p_1, 0) + wasm_i16x8_extract_lane(p_1, 1) +
+                wasm_i16x8_extract_lane(p_1, 2) + wasm_i16x8_extract_lane(p_1, 3) +
+                wasm_i16x8_extract_lane(p_1, 4) + wasm_i16x8_extract_lane(p_1, 5) +
+                wasm_i16x8_extract_lane(p_1, 6) + wasm_i16x8_extract_lane(p_1, 7));
+    }
+
+    sumf = sum0 + sum1;
+#endif
+
+    *s = sumf;
+}
+#endif
+
+#if __AVX512F__ && QK == 32
+static inline __m512 dot_q4_0_q8_0_oneblock_avx512(
+    __m512 acc,
+    const block_q4_0 * restrict x,
+    const block_q8_0 * restrict y,
+    int i
+) {
+    // Compute combined scale for the block
+    __m512 d = _mm512_set1_ps( x[i].d * y[i].d );
+
+    __m256i bx = bytesFromNibbles( x[i].qs );
+    __m256i by = _mm256_loadu_si256( ( const __m256i* )y[i].qs );
+
+    // Now we have a vector with bytes in [ 0 .. 15 ] interval. Offset them into [ -8 .. +7 ] interval.
+    const __m256i off = _mm256_set1_epi8( 8 );
+    bx = _mm256_sub_epi8( bx, off );
+
+    // Sign-extend 32 signed bytes into int16_t
+    __m512i x32 = _mm512_cvtepi8_epi16( bx );
+    __m512i y32 = _mm512_cvtepi8_epi16( by );
+    // Compute products of int16_t integers, add pairwise
+    __m512i i64 = _mm512_madd_epi16( x32, y32 );
+
+    // Convert int32_t to float
+    __m512 p = _mm512_cvtepi32_ps( i64 );
+    // Apply the scale, and accumulate
+    return _mm512_fmadd_ps( d, p, acc );
+}
+
+static inline __m512 dot_q4_1_q8_1_oneblock_avx512(
+    __m512 acc,
+    const block_q4_1 * restrict x,
+    const block_q8_1 * restrict y,
+    int i
+) {
+    // Compute combined scale for the block
+    __m512 d = _mm512_set1_ps( x[i].d * y[i].d );
+
+    // Bytes in [ 0 .. 15 ] interval, zero-extended, times signed bytes
+    __m512i x32 = _mm512_cvtepu8_epi16( bytesFromNibbles( x[i].qs ) );
+    __m512i y32 = _mm512_cvtepi8_epi16( _mm256_loadu_si256( ( const __m256i* )y[i].qs ) );
+    // Compute products of int16_t integers, add pairwise
+    __m512i i64 = _mm512_madd_epi16( x32, y32 );
+
+    // Convert int32_t to float
+    __m512 p = _mm512_cvtepi32_ps( i64 );
+    // Apply the scale, and accumulate
+    return _mm512_fmadd_ps( d, p, acc );
+}
+#endif
+
+#if __AVX2__
+// horizontal sum of the 8 floats of an AVX vector
+static inline float hsum_float_8(const __m256 x) {
+    __m128 res = _mm256_extractf128_ps( x, 1 );
+    res = _mm_add_ps( res, _mm256_castps256_ps128( x ) );
+    res = _mm_add_ps( res, _mm_movehl_ps( res, res ) );
+    res = _mm_add_ss( res, _mm_movehdup_ps( res ) );
+    return _mm_cvtss_f32( res );
+}
+
+// add the products of the unsigned bytes of ax and the signed bytes of sy in groups of 4 into 8 int32_t
+static inline __m256i mul_sum_us8_pairs(const __m256i ax, const __m256i sy) {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32( _mm256_setzero_si256(), ax, sy );
+#elif defined(__AVXVNNI__)
+    return _mm256_dpbusd_avx_epi32( _mm256_setzero_si256(), ax, sy );
+#else
+    // no saturation: the unsigned bytes are at most 127 and the signed ones at least -127
+    const __m256i dot = _mm256_maddubs_epi16( ax, sy );
+    return _mm256_madd_epi16( dot, _mm256_set1_epi16( 1 ) );
+#endif
+}
+#endif
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__) && QK == 32
+#define GGML_VNNI512
+
+// two blocks of 32 bytes in the halves of an AVX-512 vector
+static inline __m512i bytes_from_two_blocks(const __m256i b0, const __m256i b1) {
+    return _mm512_inserti64x4( _mm512_castsi256_si512( b0 ), b1, 1 );
+}
+
+// dot products of two blocks of 32 signed bytes of the weights with two q8_0 blocks of activations, with vpdpbusd
+// the int32 sums of a block are only converted to float to apply its scales d0*y0->d and d1*y1->d
+// an odd last block can be passed twice with d1 = 0
+static inline __m512 dot_i8_q8_0_twoblocks_avx512vnni(
+    __m512 acc,
+    const float d0, const __m256i bx0, const block_q8_0 * restrict y0,
+    const float d1, const __m256i bx1, const block_q8_0 * restrict y1
+) {
+    const __m512i bx = bytes_from_two_blocks( bx0, bx1 );
+    const __m512i by = bytes_from_two_blocks( _mm256_loadu_si256( ( const __m256i* )y0->qs ), _mm256_loadu_si256( ( const __m256i* )y1->qs ) );
+
+    // vpdpbusd needs an unsigned operand: move the sign of x onto y
+    const __m512i ax = _mm512_abs_epi8( bx );
+    const __m512i sy = _mm512_mask_sub_epi8( by, _mm512_movepi8_mask( bx ), _mm512_setzero_si512(), by );
+
+    const __m512 p = _mm512_cvtepi32_ps( _mm512_dpbusd_epi32( _mm512_setzero_si512(), ax, sy ) );
+    const __m512 d = _mm512_mask_blend_ps( 0xFF00, _mm512_set1_ps( d0*y0->d ), _mm512_set1_ps( d1*y1->d ) );
+
+    return _mm512_fmadd_ps( d, p, acc );
+}
+
+// same with two blocks of 32 unsigned bytes of the weights and two q8_1 blocks of activations, no sign to move
+static inline __m512 dot_u8_q8_1_twoblocks_avx512vnni(
+    __m512 acc,
+    const float d0, const __m256i bx0, const block_q8_1 * restrict y0,
+    const float d1, const __m256i bx1, const block_q8_1 * restrict y1
+) {
+    const __m512i bx = bytes_from_two_blocks( bx0, bx1 );
+    const __m512i by = bytes_from_two_blocks( _mm256_loadu_si256( ( const __m256i* )y0->qs ), _mm256_loadu_si256( ( const __m256i* )y1->qs ) );
+
+    const __m512 p = _mm512_cvtepi32_ps( _mm512_dpbusd_epi32( _mm512_setzero_si512(), bx, by ) );
+    const __m512 d = _mm512_mask_blend_ps( 0xFF00, _mm512_set1_ps( d0*y0->d ), _mm512_set1_ps( d1*y1->d ) );
+
+    return _mm512_fmadd_ps( d, p, acc );
+}
+#endif
+
+// q4_0 weights times q8_0 activations
+static void ggml_vec_dot_q4_0_q8_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q4_0 * restrict x = vx;
+    const block_q8_0 * restrict y = vy;
+
+    float sumf = 0.0;
+
+#if defined(GGML_VNNI512)
+    __m512 acc = _mm512_setzero_ps();
+
+    // Offset the nibbles into [ -8 .. +7 ] interval
+    const __m256i off = _mm256_set1_epi8( 8 );
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc,
+                x[i+0].d, _mm256_sub_epi8( bytesFromNibbles( x[i+0].qs ), off ), &y[i+0],
+                x[i+1].d, _mm256_sub_epi8( bytesFromNibbles( x[i+1].qs ), off ), &y[i+1] );
+    }
+    for (; i < nb; ++i) {
+        const __m256i bx = _mm256_sub_epi8( bytesFromNibbles( x[i].qs ), off );
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc, x[i].d, bx, &y[i], 0.0f, bx, &y[i] );
+    }
+
+    sumf = _mm512_reduce_add_ps( acc );
+#elif defined(__AVX512F__) && QK == 32
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc0 = dot_q4_0_q8_0_oneblock_avx512( acc0, x, y, i+0 );
+        acc1 = dot_q4_0_q8_0_oneblock_avx512( acc1, x, y, i+1 );
+    }
+    for (; i < nb; ++i) {
+        acc0 = dot_q4_0_q8_0_oneblock_avx512( acc0, x, y, i );
+    }
+
+    sumf = _mm512_reduce_add_ps( _mm512_add_ps( acc0, acc1 ) );
+#elif defined(__AVX2__)
+    // Initialize accumulator with zeros
+    __m256 acc = _mm256_setzero_ps();
+
+    // Main loop
+    for (int i = 0; i < nb; ++i) {
+        // Compute combined scale for the block
+        const __m256 d = _mm256_mul_ps( _mm256_broadcast_ss( &x[i].d ), _mm256_broadcast_ss( &y[i].d ) );
+
+        // Load 16 bytes, and unpack 4 bit fields into bytes, making 32 bytes
+        __m256i bx = bytesFromNibbles( x[i].qs );
+
+        // Now we have a vector with bytes in [ 0 .. 15 ] interval. Offset them into [ -8 .. +7 ] interval.
+        const __m256i off = _mm256_set1_epi8( 8 );
+        bx = _mm256_sub_epi8( bx, off );
+
+        __m256i by = _mm256_loadu_si256( ( const __m256i* )y[i].qs );
+
+        // maddubs needs an unsigned operand: move the sign of x onto y
+        const __m256i ax = _mm256_sign_epi8( bx, bx );
+        const __m256i sy = _mm256_sign_epi8( by, bx );
+
+        // Convert int32_t to float
+        const __m256 p = _mm256_cvtepi32_ps( mul_sum_us8_pairs( ax, sy ) );
+        // Apply the scale, and accumulate
+        acc = _mm256_fmadd_ps( d, p, acc );
+    }
+
+    sumf = hsum_float_8( acc );
+#else
+    // scalar
+    for (int i = 0; i < nb; i++) {
+        const float d0 = x[i].d;
+        const float d1 = y[i].d;
+
+        const uint8_t * restrict p0 = x[i].qs;
+        const  int8_t * restrict p1 = y[i].qs;
+
+        int sumi = 0;
+        for (int j = 0; j < QK/2; j++) {
+            const uint8_t v0 = p0[j];
+
+            const int i0 = (int8_t) (v0 & 0xf) - 8;
+            const int i1 = (int8_t) (v0 >> 4)  - 8;
+
+            sumi += i0*p1[2*j + 0] + i1*p1[2*j + 1];
+        }
+        sumf += d0*d1*sumi;
+    }
+#endif
+
+    *s = sumf;
+}
+
+// q4_1 weights times q8_1 activations
+static void ggml_vec_dot_q4_1_q8_1(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q4_1 * restrict x = vx;
+    const block_q8_1 * restrict y = vy;
+
+    float sumf = 0.0;
+
+    // sum((d0*q0 + m0)*d1*q1) = d0*d1*sum(q0*q1) + m0*(d1*sum(q1))
+    float summs = 0.0f;
+
+#if defined(GGML_VNNI512)
+    __m512 acc = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc = dot_u8_q8_1_twoblocks_avx512vnni( acc,
+                x[i+0].d, bytesFromNibbles( x[i+0].qs ), &y[i+0],
+                x[i+1].d, bytesFromNibbles( x[i+1].qs ), &y[i+1] );
+        summs += x[i+0].m*y[i+0].s + x[i+1].m*y[i+1].s;
+    }
+    for (; i < nb; ++i) {
+        const __m256i bx = bytesFromNibbles( x[i].qs );
+        acc = dot_u8_q8_1_twoblocks_avx512vnni( acc, x[i].d, bx, &y[i], 0.0f, bx, &y[i] );
+        summs += x[i].m*y[i].s;
+    }
+
+    sumf = _mm512_reduce_add_ps( acc ) + summs;
+#elif defined(__AVX512F__) && QK == 32
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc0 = dot_q4_1_q8_1_oneblock_avx512( acc0, x, y, i+0 );
+        acc1 = dot_q4_1_q8_1_oneblock_avx512( acc1, x, y, i+1 );
+        summs += x[i+0].m*y[i+0].s + x[i+1].m*y[i+1].s;
+    }
+    for (; i < nb; ++i) {
+        acc0 = dot_q4_1_q8_1_oneblock_avx512( acc0, x, y, i );
+        summs += x[i].m*y[i].s;
+    }
+
+    sumf = _mm512_reduce_add_ps( _mm512_add_ps( acc0, acc1 ) ) + summs;
+#elif defined(__AVX2__)
+    // Initialize accumulator with zeros
+    __m256 acc = _mm256_setzero_ps();
+
+    // Main loop
+    for (int i = 0; i < nb; ++i) {
+        // Compute combined scale for the block
+        const __m256 d = _mm256_mul_ps( _mm256_broadcast_ss( &x[i].d ), _mm256_broadcast_ss( &y[i].d ) );
+
+        summs += x[i].m*y[i].s;
+
+        // Load 16 bytes, and unpack 4 bit fields into bytes in [ 0 .. 15 ] interval
+        const __m256i bx = bytesFromNibbles( x[i].qs );
+        const __m256i by = _mm256_loadu_si256( ( const __m256i* )y[i].qs );
+
+        // Convert int32_t to float
+        const __m256 p = _mm256_cvtepi32_ps( mul_sum_us8_pairs( bx, by ) );
+        // Apply the scale, and accumulate
+        acc = _mm256_fmadd_ps( d, p, acc );
+    }
+
+    sumf = hsum_float_8( acc ) + summs;
+#else
+    // scalar
+    for (int i = 0; i < nb; i++) {
+        const float d0 = x[i].d;
+        const float d1 = y[i].d;
+
+        const uint8_t * restrict p0 = x[i].qs;
+        const  int8_t * restrict p1 = y[i].qs;
+
+        int sumi = 0;
+        for (int j = 0; j < QK/2; j++) {
+            const uint8_t v0 = p0[j];
+
+            sumi += (v0 & 0xf)*p1[2*j + 0] + (v0 >> 4)*p1[2*j + 1];
+        }
+        sumf += d0*d1*sumi;
+        summs += x[i].m*y[i].s;
+    }
+    sumf += summs;
+#endif
+
+    *s = sumf;
+}
+
+#if __AVX2__ || __AVX512F__
+// Unpack the 32 5-bit quants of a q5_0 block into 32 signed bytes in [ -16 .. +15 ] interval
+static inline __m256i bytes_from_q5_0( const block_q5_0 * restrict x )
+{
+    const __m256i bx = bytesFromNibbles( x->qs );
+
+    // 0xF0 where the 5th bit is clear, i.e. subtract 16 from the nibbles of these quants
+    __m256i bxhi = bytesFromBits( x->qh );
+    bxhi = _mm256_andnot_si256( bxhi, _mm256_set1_epi8( (char) 0xF0 ) );
+
+    return _mm256_or_si256( bx, bxhi );
+}
+#endif
+
+#if __AVX512F__ && QK == 32
+// dot product of 32 signed bytes of the weights with a q8_0 block of activations
+static inline __m512 dot_i8_q8_0_oneblock_avx512(
+    __m512 acc,
+    const float d,
+    const __m256i bx,
+    const block_q8_0 * restrict y
+) {
+    // Sign-extend 32 signed bytes into int16_t
+    __m512i x32 = _mm512_cvtepi8_epi16( bx );
+    __m512i y32 = _mm512_cvtepi8_epi16( _mm256_loadu_si256( ( const __m256i* )y->qs ) );
+    // Compute products of int16_t integers, add pairwise
+    __m512i i64 = _mm512_madd_epi16( x32, y32 );
+
+    // Convert int32_t to float
+    __m512 p = _mm512_cvtepi32_ps( i64 );
+    // Apply the scale, and accumulate
+    return _mm512_fmadd_ps( _mm512_set1_ps( d*y->d ), p, acc );
+}
+#endif
+
+#if __AVX2__
+// dot product of 32 signed bytes of the weights with a q8_0 block of activations
+static inline __m256 dot_i8_q8_0_oneblock_avx2(
+    __m256 acc,
+    const float d,
+    const __m256i bx,
+    const block_q8_0 * restrict y
+) {
+    const __m256i by = _mm256_loadu_si256( ( const __m256i* )y->qs );
+
+    // maddubs needs an unsigned operand: move the sign of x onto y
+    const __m256i ax = _mm256_sign_epi8( bx, bx );
+    const __m256i sy = _mm256_sign_epi8( by, bx );
+
+    // Convert int32_t to float
+    const __m256 p = _mm256_cvtepi32_ps( mul_sum_us8_pairs( ax, sy ) );
+    // Apply the scale, and accumulate
+    return _mm256_fmadd_ps( _mm256_set1_ps( d*y->d ), p, acc );
+}
+#endif
+
+// q5_0 weights times q8_0 activations
+static void ggml_vec_dot_q5_0_q8_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q5_0 * restrict x = vx;
+    const block_q8_0 * restrict y = vy;
+
+    float sumf = 0.0;
+
+#if defined(GGML_VNNI512)
+    __m512 acc = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc,
+                x[i+0].d, bytes_from_q5_0( &x[i+0] ), &y[i+0],
+                x[i+1].d, bytes_from_q5_0( &x[i+1] ), &y[i+1] );
+    }
+    for (; i < nb; ++i) {
+        const __m256i bx = bytes_from_q5_0( &x[i] );
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc, x[i].d, bx, &y[i], 0.0f, bx, &y[i] );
+    }
+
+    sumf = _mm512_reduce_add_ps( acc );
+#elif defined(__AVX512F__) && QK == 32
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc0 = dot_i8_q8_0_oneblock_avx512( acc0, x[i+0].d, bytes_from_q5_0( &x[i+0] ), &y[i+0] );
+        acc1 = dot_i8_q8_0_oneblock_avx512( acc1, x[i+1].d, bytes_from_q5_0( &x[i+1] ), &y[i+1] );
+    }
+    for (; i < nb; ++i) {
+        acc0 = dot_i8_q8_0_oneblock_avx512( acc0, x[i].d, bytes_from_q5_0( &x[i] ), &y[i] );
+    }
+
+    sumf = _mm512_reduce_add_ps( _mm512_add_ps( acc0, acc1 ) );
+#elif defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        acc = dot_i8_q8_0_oneblock_avx2( acc, x[i].d, bytes_from_q5_0( &x[i] ), &y[i] );
+    }
+
+    sumf = hsum_float_8( acc );
+#else
+    // scalar
+    for (int i = 0; i < nb; i++) {
+        const float d0 = x[i].d;
+        const float d1 = y[i].d;
+
+        const uint8_t * restrict p0 = x[i].qs;
+        const  int8_t * restrict p1 = y[i].qs;
+
+        uint32_t qh;
+        memcpy(&qh, x[i].qh, sizeof(qh));
+
+        int sumi = 0;
+        for (int j = 0; j < QK/2; j++) {
+            const uint8_t v0 = p0[j];
+
+            const int i0 = (int8_t) ((v0 & 0xf) | (((qh >> (2*j + 0)) & 1) << 4)) - 16;
+            const int i1 = (int8_t) ((v0 >> 4)  | (((qh >> (2*j + 1)) & 1) << 4)) - 16;
+
+            sumi += i0*p1[2*j + 0] + i1*p1[2*j + 1];
+        }
+        sumf += d0*d1*sumi;
+    }
+#endif
+
+    *s = sumf;
+}
+
+// q8_0 weights times q8_0 activations
+static void ggml_vec_dot_q8_0_q8_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q8_0 * restrict x = vx;
+    const block_q8_0 * restrict y = vy;
+
+    float sumf = 0.0;
+
+#if defined(GGML_VNNI512)
+    __m512 acc = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc,
+                x[i+0].d, _mm256_loadu_si256( ( const __m256i* )x[i+0].qs ), &y[i+0],
+                x[i+1].d, _mm256_loadu_si256( ( const __m256i* )x[i+1].qs ), &y[i+1] );
+    }
+    for (; i < nb; ++i) {
+        const __m256i bx = _mm256_loadu_si256( ( const __m256i* )x[i].qs );
+        acc = dot_i8_q8_0_twoblocks_avx512vnni( acc, x[i].d, bx, &y[i], 0.0f, bx, &y[i] );
+    }
+
+    sumf = _mm512_reduce_add_ps( acc );
+#elif defined(__AVX512F__) && QK == 32
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    int i = 0;
+    for (; i + 1 < nb; i += 2) {
+        acc0 = dot_i8_q8_0_oneblock_avx512( acc0, x[i+0].d, _mm256_loadu_si256( ( const __m256i* )x[i+0].qs ), &y[i+0] );
+        acc1 = dot_i8_q8_0_oneblock_avx512( acc1, x[i+1].d, _mm256_loadu_si256( ( const __m256i* )x[i+1].qs ), &y[i+1] );
+    }
+    for (; i < nb; ++i) {
+        acc0 = dot_i8_q8_0_oneblock_avx512( acc0, x[i].d, _mm256_loadu_si256( ( const __m256i* )x[i].qs ), &y[i] );
+    }
+
+    sumf = _mm512_reduce_add_ps( _mm512_add_ps( acc0, acc1 ) );
+#elif defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        acc = dot_i8_q8_0_oneblock_avx2( acc, x[i].d, _mm256_loadu_si256( ( const __m256i* )x[i].qs ), &y[i] );
+    }
+
+    sumf = hsum_float_8( acc );
+#else
+    // scalar
+    for (int i = 0; i < nb; i++) {
+        const int8_t * restrict p0 = x[i].qs;
+        const int8_t * restrict p1 = y[i].qs;
+
+        int sumi = 0;
+        for (int j = 0; j < QK; j++) {
+            sumi += p0[j]*p1[j];
+        }
+        sumf += x[i].d*y[i].d*sumi;
+    }
+#endif
+
+    *s = sumf;
+}
+
+// quantized gemm micro-kernels, see GGML_GEMM_MR
+#if __AVX2__
+// accumulate the products of the signed bytes bx of the MR rows with the q8_0 blocks y[0 .. NR-1]
+static inline void gemm_i8_q8_0_block_avx2(
+    __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR],
+    const __m256i bx[GGML_GEMM_MR],
+    const float dx[GGML_GEMM_MR],
+    const block_q8_0 * const y[GGML_GEMM_NR]
+) {
+    // maddubs needs an unsigned operand: the sign of x is moved onto y below
+    __m256i ax[GGML_GEMM_MR];
+    __m256  dxv[GGML_GEMM_MR];
+    for (int r = 0; r < GGML_GEMM_MR; ++r) {
+        ax[r]  = _mm256_sign_epi8( bx[r], bx[r] );
+        dxv[r] = _mm256_set1_ps( dx[r] );
+    }
+
+    for (int c = 0; c < GGML_GEMM_NR; ++c) {
+        const __m256i by  = _mm256_loadu_si256( ( const __m256i* )y[c]->qs );
+        const __m256  dyv = _mm256_set1_ps( y[c]->d );
+
+        for (int r = 0; r < GGML_GEMM_MR; ++r) {
+            const __m256i sy = _mm256_sign_epi8( by, bx[r] );
+            const __m256  p  = _mm256_cvtepi32_ps( mul_sum_us8_pairs( ax[r], sy ) );
+
+            acc[r][c] = _mm256_fmadd_ps( _mm256_mul_ps( dxv[r], dyv ), p, acc[r][c] );
+        }
+    }
+}
+
+static inline void gemm_store_avx2(float * restrict s, const int ss, __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR]) {
+    for (int r = 0; r < GGML_GEMM_MR; ++r) {
+        for (int c = 0; c < GGML_GEMM_NR; ++c) {
+            s[r + c*ss] = hsum_float_8( acc[r][c] );
+        }
+    }
+}
+
+// q4_0 weights times q8_0 activations
+static void ggml_gemm_q4_0_q8_0(const int n, float * restrict s, const int ss, const void * restrict vx, const size_t bx, const void * restrict vy, const size_t by) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q4_0 * x[GGML_GEMM_MR];
+    const block_q8_0 * y[GGML_GEMM_NR];
+
+    for (int r = 0; r < GGML_GEMM_MR; ++r) x[r] = (const block_q4_0 *) ((const char *) vx + r*bx);
+    for (int c = 0; c < GGML_GEMM_NR; ++c) y[c] = (const block_q8_0 *) ((const char *) vy + c*by);
+
+    __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR];
+    for (int r = 0; r < GGML_GEMM_MR; ++r) for (int c = 0; c < GGML_GEMM_NR; ++c) acc[r][c] = _mm256_setzero_ps();
+
+    const __m256i off = _mm256_set1_epi8( 8 );
+
+    for (int i = 0; i < nb; ++i) {
+        __m256i bxi[GGML_GEMM_MR];
+        float   dxi[GGML_GEMM_MR];
+        const block_q8_0 * yi[GGML_GEMM_NR];
+
+        for (int r = 0; r < GGML_GEMM_MR; ++r) {
+            // Offset the nibbles into [ -8 .. +7 ] interval
+            bxi[r] = _mm256_sub_epi8( bytesFromNibbles( x[r][i].qs ), off );
+            dxi[r] = x[r][i].d;
+        }
+        for (int c = 0; c < GGML_GEMM_NR; ++c) yi[c] = &y[c][i];
+
+        gemm_i8_q8_0_block_avx2(acc, bxi, dxi, yi);
+    }
+
+    gemm_store_avx2(s, ss, acc);
+}
+
+// q5_0 weights times q8_0 activations
+static void ggml_gemm_q5_0_q8_0(const int n, float * restrict s, const int ss, const void * restrict vx, const size_t bx, const void * restrict vy, const size_t by) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q5_0 * x[GGML_GEMM_MR];
+    const block_q8_0 * y[GGML_GEMM_NR];
+
+    for (int r = 0; r < GGML_GEMM_MR; ++r) x[r] = (const block_q5_0 *) ((const char *) vx + r*bx);
+    for (int c = 0; c < GGML_GEMM_NR; ++c) y[c] = (const block_q8_0 *) ((const char *) vy + c*by);
+
+    __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR];
+    for (int r = 0; r < GGML_GEMM_MR; ++r) for (int c = 0; c < GGML_GEMM_NR; ++c) acc[r][c] = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        __m256i bxi[GGML_GEMM_MR];
+        float   dxi[GGML_GEMM_MR];
+        const block_q8_0 * yi[GGML_GEMM_NR];
+
+        for (int r = 0; r < GGML_GEMM_MR; ++r) {
+            bxi[r] = bytes_from_q5_0( &x[r][i] );
+            dxi[r] = x[r][i].d;
+        }
+        for (int c = 0; c < GGML_GEMM_NR; ++c) yi[c] = &y[c][i];
+
+        gemm_i8_q8_0_block_avx2(acc, bxi, dxi, yi);
+    }
+
+    gemm_store_avx2(s, ss, acc);
+}
+
+// q8_0 weights times q8_0 activations
+static void ggml_gemm_q8_0_q8_0(const int n, float * restrict s, const int ss, const void * restrict vx, const size_t bx, const void * restrict vy, const size_t by) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+
+    const block_q8_0 * x[GGML_GEMM_MR];
+    const block_q8_0 * y[GGML_GEMM_NR];
+
+    for (int r = 0; r < GGML_GEMM_MR; ++r) x[r] = (const block_q8_0 *) ((const char *) vx + r*bx);
+    for (int c = 0; c < GGML_GEMM_NR; ++c) y[c] = (const block_q8_0 *) ((const char *) vy + c*by);
+
+    __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR];
+    for (int r = 0; r < GGML_GEMM_MR; ++r) for (int c = 0; c < GGML_GEMM_NR; ++c) acc[r][c] = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        __m256i bxi[GGML_GEMM_MR];
+        float   dxi[GGML_GEMM_MR];
+        const block_q8_0 * yi[GGML_GEMM_NR];
+
+        for (int r = 0; r < GGML_GEMM_MR; ++r) {
+            bxi[r] = _mm256_loadu_si256( ( const __m256i* )x[r][i].qs );
+            dxi[r] = x[r][i].d;
+        }
+        for (int c = 0; c < GGML_GEMM_NR; ++c) yi[c] = &y[c][i];
+
+        gemm_i8_q8_0_block_avx2(acc, bxi, dxi, yi);
+    }
+
+    gemm_store_avx2(s, ss, acc);
+}
+
+// q4_1 weights times q8_1 activations
+static void ggml_gemm_q4_1_q8_1(const int n, float * restrict s, const int ss, const void * restrict vx, const size_t bx, const void * restrict vy, const size_t by) {
+    const int nb = n / QK;
+
+    assert(n % QK == 0);
+    static_assert(GGML_GEMM_MR == 2 && GGML_GEMM_NR == 4, "the min terms of a tile must fill an AVX vector");
+
+    const block_q4_1 * x[GGML_GEMM_MR];
+    const block_q8_1 * y[GGML_GEMM_NR];
+
+    for (int r = 0; r < GGML_GEMM_MR; ++r) x[r] = (const block_q4_1 *) ((const char *) vx + r*bx);
+    for (int c = 0; c < GGML_GEMM_NR; ++c) y[c] = (const block_q8_1 *) ((const char *) vy + c*by);
+
+    __m256 acc[GGML_GEMM_MR][GGML_GEMM_NR];
+    for (int r = 0; r < GGML_GEMM_MR; ++r) for (int c = 0; c < GGML_GEMM_NR; ++c) acc[r][c] = _mm256_setzero_ps();
+
+    // the min terms m0*(d1*sum(q1)) of the whole tile, see ggml_vec_dot_q4_1_q8_1
+    // lane r*NR + c holds the one of row r and column c
+    __m256 summs = _mm256_setzero_ps();
+
+    for (int i = 0; i < nb; ++i) {
+        // unsigned bytes in [ 0 .. 15 ] interval, no need to move their sign
+        __m256i bxi[GGML_GEMM_MR];
+        __m256  dxv[GGML_GEMM_MR];
+
+        for (int r = 0; r < GGML_GEMM_MR; ++r) {
+            bxi[r] = bytesFromNibbles( x[r][i].qs );
+            dxv[r] = _mm256_set1_ps( x[r][i].d );
+        }
+
+        for (int c = 0; c < GGML_GEMM_NR; ++c) {
+            const __m256i qy  = _mm256_loadu_si256( ( const __m256i* )y[c][i].qs );
+            const __m256  dyv = _mm256_set1_ps( y[c][i].d );
+
+            for (int r = 0; r < GGML_GEMM_MR; ++r) {
+                const __m256 p = _mm256_cvtepi32_ps( mul_sum_us8_pairs( bxi[r], qy ) );
+
+                acc[r][c] = _mm256_fmadd_ps( _mm256_mul_ps( dxv[r], dyv ), p, acc[r][c] );
+            }
+        }
+
+        const __m128 s4 = _mm_setr_ps( y[0][i].s, y[1][i].s, y[2][i].s, y[3][i].s );
+        const __m256 mv = _mm256_setr_m128( _mm_set1_ps( x[0][i].m ), _mm_set1_ps( x[1][i].m ) );
+
+        summs = _mm256_fmadd_ps( mv, _mm256_setr_m128( s4, s4 ), summs );
+    }
+
+    gemm_store_avx2(s, ss, acc);
+
+    float m[GGML_GEMM_MR*GGML_GEMM_NR];
+    _mm256_storeu_ps( m, summs );
+
+    for (int r = 0; r < GGML_GEMM_MR; ++r) {
+        for (int c = 0; c < GGML_GEMM_NR; ++c) {
+            s[r + c*ss] += m[r*GGML_GEMM_NR + c];
+        }
+    }
+}
+#endif
+
+//
+// fp16 rows
+//
+
+static void ggml_fp16_to_fp32_row(const ggml_fp16_t * restrict x, float * restrict y, int n) {
+    int i = 0;
+
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(y + i, _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *) (x + i))));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(y + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (x + i))));
+    }
+#endif
+
+    for (; i < n; i++) {
+        y[i] = ggml_fp16_to_fp32(x[i]);
+    }
+}
+
+static void ggml_fp32_to_fp16_row(const float * restrict x, ggml_fp16_t * restrict y, int n) {
+    int i = 0;
+
+#if defined(__AVX512F__)
+    for (; i + 16 <= n; i += 16) {
+        _mm256_storeu_si256((__m256i *) (y + i), _mm512_cvtps_ph(_mm512_loadu_ps(x + i), 0));
+    }
+#elif defined(__F16C__)
+    for (; i + 8 <= n; i += 8) {
+        _mm_storeu_si128((__m128i *) (y + i), _mm256_cvtps_ph(_mm256_loadu_ps(x + i), 0));
+    }
+#endif
+
+    for (; i < n; i++) {
+        y[i] = ggml_fp32_to_fp16(x[i]);
+    }
+}
+
+//
+// f32 and f16 dot products
+//
+
+static void ggml_vec_dot_f32(const int n, float * restrict s, const float * restrict x, const float * restrict y) {
+#ifdef GGML_SIMD
+    float sumf = 0.0f;
+    const int np = (n & ~(GGML_F32_STEP - 1));
+
+    GGML_F32_VEC sum[GGML_F32_ARR] = { GGML_F32_VEC_ZERO };
+
+    GGML_F32_VEC ax[GGML_F32_ARR];
+    GGML_F32_VEC ay[GGML_F32_ARR];
+
+    for (int i = 0; i < np; i += GGML_F32_STEP) {
+        for (int j = 0; j < GGML_F32_ARR; j++) {
+            ax[j] = GGML_F32_VEC_LOAD(x + i + j*GGML_F32_EPR);
+            ay[j] = GGML_F32_VEC_LOAD(y + i + j*GGML_F32_EPR);
+
+            sum[j] = GGML_F32_VEC_FMA(sum[j], ax[j], ay[j]);
+        }
+    }
+
+    // reduce sum0..sum3 to sum0
+    GGML_F32_VEC_REDUCE(sumf, sum);
+
+    // leftovers
+    for (int i = np; i < n; ++i) {
+        sumf += x[i]*y[i];
+    }
+#else
+    // scalar
+    ggml_float sumf = 0.0;
+    for (int i = 0; i < n; ++i) {
+        sumf += (ggml_float)(x[i]*y[i]);
+    }
+#endif
+
+    *s = sumf;
+}
+
+static void ggml_vec_dot_f16(const int n, float * restrict s, ggml_fp16_t * restrict x, ggml_fp16_t * restrict y) {
+    ggml_float sumf = 0.0;
+
+#if defined(GGML_SIMD)
+    const int np = (n & ~(GGML_F16_STEP - 1));
+
+    GGML_F16_VEC sum[GGML_F16_ARR] = { GGML_F16_VEC_ZERO };
+
+    GGML_F16_VEC ax[GGML_F16_ARR];
+    GGML_F16_VEC ay[GGML_F16_ARR];
+
+    for (int i = 0; i < np; i += GGML_F16_STEP) {
+        for (int j = 0; j < GGML_F16_ARR; j++) {
+            ax[j] = GGML_F16_VEC_LOAD(x + i + j*GGML_F16_EPR, j);
+            ay[j] = GGML_F16_VEC_LOAD(y + i + j*GGML_F16_EPR, j);
+
+            sum[j] = GGML_F16_VEC_FMA(sum[j], ax[j], ay[j]);
+        }
+    }
+
+    // reduce sum0..sum3 to sum0
+    GGML_F16_VEC_REDUCE(sumf, sum);
+
+    // leftovers
+    for (int i = np; i < n; ++i) {
+        sumf += (ggml_float)(GGML_FP16_TO_FP32(x[i])*GGML_FP16_TO_FP32(y[i]));
+    }
+#else
+    for (int i = 0; i < n; ++i) {
+        sumf += (ggml_float)(GGML_FP16_TO_FP32(x[i])*GGML_FP16_TO_FP32(y[i]));
+    }
+#endif
+
+    *s = sumf;
+}
+
+//
+// packed sgemm
+//
+
+#if defined(__AVX512F__)
+#define GGML_SGEMM_MR 32
+#define GGML_SGEMM_NR 12
+#elif defined(__AVX2__) && defined(__FMA__)
+#define GGML_SGEMM_MR 16
+#define GGML_SGEMM_NR 6
+#endif
+
+#if defined(GGML_SGEMM_MR)
+static_assert(GGML_SGEMM_MC % GGML_SGEMM_MR == 0, "GGML_SGEMM_MC must be a multiple of GGML_SGEMM_MR");
+static_assert(GGML_SGEMM_MR*GGML_SGEMM_NR <= GGML_SGEMM_TILE_MAX, "GGML_SGEMM_TILE_MAX is too small");
+
+// c[r + j*ldc] (+)= sum_k a[k*MR + r]*b[k*NR + j] for r < MR and j < NR
+static void ggml_sgemm_kernel(const int kc, const float * restrict a, const float * restrict b, float * restrict c, const int ldc, const bool add) {
+#if defined(__AVX512F__)
+    __m512 acc[GGML_SGEMM_NR][2];
+
+    for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+        acc[j][0] = _mm512_setzero_ps();
+        acc[j][1] = _mm512_setzero_ps();
+    }
+
+    for (int k = 0; k < kc; ++k) {
+        const __m512 a0 = _mm512_loadu_ps(a + k*GGML_SGEMM_MR);
+        const __m512 a1 = _mm512_loadu_ps(a + k*GGML_SGEMM_MR + 16);
+
+        for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+            const __m512 bj = _mm512_set1_ps(b[k*GGML_SGEMM_NR + j]);
+
+            acc[j][0] = _mm512_fmadd_ps(a0, bj, acc[j][0]);
+            acc[j][1] = _mm512_fmadd_ps(a1, bj, acc[j][1]);
+        }
+    }
+
+    for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+        if (add) {
+            acc[j][0] = _mm512_add_ps(acc[j][0], _mm512_loadu_ps(c + j*ldc));
+            acc[j][1] = _mm512_add_ps(acc[j][1], _mm512_loadu_ps(c + j*ldc + 16));
+        }
+        _mm512_storeu_ps(c + j*ldc,      acc[j][0]);
+        _mm512_storeu_ps(c + j*ldc + 16, acc[j][1]);
+    }
+#else
+    __m256 acc[GGML_SGEMM_NR][2];
+
+    for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+        acc[j][0] = _mm256_setzero_ps();
+        acc[j][1] = _mm256_setzero_ps();
+    }
+
+    for (int k = 0; k < kc; ++k) {
+        const __m256 a0 = _mm256_loadu_ps(a + k*GGML_SGEMM_MR);
+        const __m256 a1 = _mm256_loadu_ps(a + k*GGML_SGEMM_MR + 8);
+
+        for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+            const __m256 bj = _mm256_broadcast_ss(b + k*GGML_SGEMM_NR + j);
+
+            acc[j][0] = _mm256_fmadd_ps(a0, bj, acc[j][0]);
+            acc[j][1] = _mm256_fmadd_ps(a1, bj, acc[j][1]);
+        }
+    }
+
+    for (int j = 0; j < GGML_SGEMM_NR; ++j) {
+        if (add) {
+            acc[j][0] = _mm256_add_ps(acc[j][0], _mm256_loadu_ps(c + j*ldc));
+            acc[j][1] = _mm256_add_ps(acc[j][1], _mm256_loadu_ps(c + j*ldc + 8));
+        }
+        _mm256_storeu_ps(c + j*ldc,     acc[j][0]);
+        _mm256_storeu_ps(c + j*ldc + 8, acc[j][1]);
+    }
+#endif
+}
+
+// transpose the 8x8 block in v
+static inline void ggml_sgemm_transpose8(__m256 v[8]) {
+    const __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+    const __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+    const __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(v[4], v[5]);
+    const __m256 t5 = _mm256_unpackhi_ps(v[4], v[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(v[6], v[7]);
+    const __m256 t7 = _mm256_unpackhi_ps(v[6], v[7]);
+
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    const __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    const __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44);
+    const __m256 u5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44);
+    const __m256 u7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+    v[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    v[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    v[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    v[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    v[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    v[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    v[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    v[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+// pack kc values of the mc rows starting at x (stride nb01 bytes) into panels of MR rows, pa[(r/MR)*MR*kc + k*MR + r%MR]
+// the rows are zero padded to a multiple of MR. full groups of 8 rows are transposed 8 values at a time
+// quantized rows are first dequantized into a small buffer, a group of 8 rows at a time
+static void ggml_sgemm_pack_a(const enum ggml_type type0, const char * x, const size_t nb01, int mc, int kc, float * restrict pa) {
+    dequantize_row_q_t const dequantize_row_q = type0 != GGML_TYPE_BF16 ? GGML_KERNELS_TABLE(GGML_KERNELS_VARIANT).quantize_fns[type0].dequantize_row_q : NULL;
+
+    float buf[8][GGML_SGEMM_KC];
+
+    for (int r = 0; r < GGML_PAD(mc, GGML_SGEMM_MR); r += 8) {
+        float * a = pa + (r/GGML_SGEMM_MR)*GGML_SGEMM_MR*kc + r%GGML_SGEMM_MR;
+
+        const int n = MAX(0, MIN(8, mc - r));
+
+        // the 8 rows of the group and their stride
+        enum ggml_type type = type0;
+        const char *   rows = x + r*nb01;
+        size_t         nbr  = nb01;
+
+        if (dequantize_row_q) {
+            for (int i = 0; i < n; ++i) {
+                dequantize_row_q(rows + i*nb01, buf[i], kc);
+            }
+
+            type = GGML_TYPE_F32;
+            rows = (const char *) buf;
+            nbr  = sizeof(buf[0]);
+        }
+
+#if defined(__F16C__)
+        const bool vec = true;
+#else
+        const bool vec = type != GGML_TYPE_F16;
+#endif
+
+        int k = 0;
+
+        if (vec && n == 8) {
+            for (; k + 8 <= kc; k += 8) {
+                __m256 v[8];
+
+                for (int i = 0; i < 8; ++i) {
+                    const char * row = rows + i*nbr;
+#if defined(__F16C__)
+                    if (type == GGML_TYPE_F16) {
+                        v[i] = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) ((const ggml_fp16_t *) row + k)));
+                        continue;
+                    }
+#endif
+                    if (type == GGML_TYPE_BF16) {
+                        const __m128i h = _mm_loadu_si128((const __m128i *) ((const ggml_bf16_t *) row + k));
+                        v[i] = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16));
+                        continue;
+                    }
+                    v[i] = _mm256_loadu_ps((const float *) row + k);
+                }
+
+                ggml_sgemm_transpose8(v);
+
+                for (int i = 0; i < 8; ++i) {
+                    _mm256_storeu_ps(a + (k + i)*GGML_SGEMM_MR, v[i]);
+                }
+            }
+        }
+
+        for (; k < kc; ++k) {
+            for (int i = 0; i < 8; ++i) {
+                const char * row = rows + i*nbr;
+
+                if (i >= n) {
+                    a[k*GGML_SGEMM_MR + i] = 0.0f;
+                } else if (type == GGML_TYPE_F16) {
+                    a[k*GGML_SGEMM_MR + i] = GGML_FP16_TO_FP32(((const ggml_fp16_t *) row)[k]);
+                } else if (type == GGML_TYPE_BF16) {
+                    a[k*GGML_SGEMM_MR + i] = GGML_BF16_TO_FP32(((const ggml_bf16_t *) row)[k]);
+                } else {
+                    a[k*GGML_SGEMM_MR + i] = ((const float *) row)[k];
+                }
+            }
+        }
+    }
+}
+
+#endif
+
+//
+// bf16
+//
+
+#if defined(__AVX512F__)
+// 16 bf16 to fp32
+static inline __m512 bf16x16_to_fp32(const ggml_bf16_t * x) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *) x)), 16));
+}
+#endif
+
+#if defined(__AVX2__)
+// 8 bf16 to fp32
+static inline __m256 bf16x8_to_fp32(const ggml_bf16_t * x) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) x)), 16));
+}
+#endif
+
+static void dequantize_row_bf16(const void * restrict vx, float * restrict y, int k) {
+    const ggml_bf16_t * restrict x = vx;
+
+    int i = 0;
+
+#if defined(__AVX512F__)
+    for (; i + 16 <= k; i += 16) {
+        _mm512_storeu_ps(y + i, bf16x16_to_fp32(x + i));
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= k; i += 8) {
+        _mm256_storeu_ps(y + i, bf16x8_to_fp32(x + i));
+    }
+#endif
+
+    for (; i < k; i++) {
+        y[i] = GGML_BF16_TO_FP32(x[i]);
+    }
+}
+
+static void quantize_row_bf16_reference(const float * restrict x, void * restrict vy, int k) {
+    ggml_bf16_t * restrict y = vy;
+
+    for (int i = 0; i < k; i++) {
+        y[i] = GGML_FP32_TO_BF16(x[i]);
+    }
+}
+
+static void quantize_row_bf16(const float * restrict x, void * restrict vy, int k) {
+    ggml_bf16_t * restrict y = vy;
+
+    int i = 0;
+
+#if defined(__AVX512BF16__)
+    // vcvtne2ps2bf16 rounds to nearest even too, but flushes denormals to zero
+    for (; i + 32 <= k; i += 32) {
+        _mm512_storeu_si512((__m512i *) (y + i), (__m512i) _mm512_cvtne2ps_pbh(_mm512_loadu_ps(x + i + 16), _mm512_loadu_ps(x + i)));
+    }
+#elif defined(__AVX2__)
+    for (; i + 8 <= k; i += 8) {
+        const __m256  v = _mm256_loadu_ps(x + i);
+        const __m256i u = _mm256_castps_si256(v);
+
+        // round to nearest even, NaNs are made quiet instead
+        const __m256i r = _mm256_srli_epi32(_mm256_add_epi32(u, _mm256_add_epi32(_mm256_set1_epi32(0x7fff),
+                        _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1)))), 16);
+        const __m256i q = _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(64));
+        const __m256i h = _mm256_blendv_epi8(r, q, _mm256_castps_si256(_mm256_cmp_ps(v, v, _CMP_UNORD_Q)));
+
+        _mm_storeu_si128((__m128i *) (y + i), _mm_packus_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1)));
+    }
+#endif
+
+    for (; i < k; i++) {
+        y[i] = GGML_FP32_TO_BF16(x[i]);
+    }
+}
+
+static void ggml_vec_dot_bf16(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const ggml_bf16_t * restrict x = vx;
+    const ggml_bf16_t * restrict y = vy;
+
+    int i = 0;
+    float sumf = 0.0f;
+
+#if defined(__AVX512BF16__)
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    for (; i + 64 <= n; i += 64) {
+        acc0 = _mm512_dpbf16_ps(acc0, (__m512bh) _mm512_loadu_si512(x + i),      (__m512bh) _mm512_loadu_si512(y + i));
+        acc1 = _mm512_dpbf16_ps(acc1, (__m512bh) _mm512_loadu_si512(x + i + 32), (__m512bh) _mm512_loadu_si512(y + i + 32));
+    }
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_dpbf16_ps(acc0, (__m512bh) _mm512_loadu_si512(x + i),      (__m512bh) _mm512_loadu_si512(y + i));
+    }
+
+    sumf = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(__AVX512F__)
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(bf16x16_to_fp32(x + i),      bf16x16_to_fp32(y + i),      acc0);
+        acc1 = _mm512_fmadd_ps(bf16x16_to_fp32(x + i + 16), bf16x16_to_fp32(y + i + 16), acc1);
+    }
+
+    sumf = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+#elif defined(__AVX2__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(bf16x8_to_fp32(x + i),     bf16x8_to_fp32(y + i),     acc0);
+        acc1 = _mm256_fmadd_ps(bf16x8_to_fp32(x + i + 8), bf16x8_to_fp32(y + i + 8), acc1);
+    }
+
+    sumf = hsum_float_8(_mm256_add_ps(acc0, acc1));
+#endif
+
+    for (; i < n; i++) {
+        sumf += GGML_BF16_TO_FP32(x[i])*GGML_BF16_TO_FP32(y[i]);
+    }
+
+    *s = sumf;
+}
+
+//
+// kernel table
+//
+
+#if defined(__AVX512BF16__)
+#define GGML_KERNELS_NAME "AVX512_BF16"
+#elif defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define GGML_KERNELS_NAME "AVX512_VNNI"
+#elif defined(__AVX512F__)
+#define GGML_KERNELS_NAME "AVX512"
+#elif defined(__AVXVNNI__)
+#define GGML_KERNELS_NAME "AVX_VNNI"
+#elif defined(__AVX2__)
+#define GGML_KERNELS_NAME "AVX2"
+#elif defined(__AVX__)
+#define GGML_KERNELS_NAME "AVX"
+#elif defined(__ARM_NEON)
+#define GGML_KERNELS_NAME "NEON"
+#elif defined(__wasm_simd128__)
+#define GGML_KERNELS_NAME "WASM_SIMD"
+#elif defined(__POWER9_VECTOR__)
+#define GGML_KERNELS_NAME "VSX"
+#else
+#define GGML_KERNELS_NAME "SCALAR"
+#endif
+
+const struct ggml_kernels GGML_KERNELS_TABLE(GGML_KERNELS_VARIANT) = {
+    .name = GGML_KERNELS_NAME,
+
+    .quantize_fns = {
+        [GGML_TYPE_Q4_0] = {
+            .dequantize_row_q         = dequantize_row_q4_0,
+            .quantize_row_q           = quantize_row_q4_0,
+            .quantize_row_q_reference = quantize_row_q4_0_reference,
+#if defined(__ARM_NEON) || defined(__wasm_simd128__)
+            .vec_dot_q                = ggml_vec_dot_q4_0,
+            .vec_dot_type             = GGML_TYPE_Q4_0,
+#else
+            .vec_dot_q                = ggml_vec_dot_q4_0_q8_0,
+            .vec_dot_type             = GGML_TYPE_Q8_0,
+#if defined(__AVX2__)
+            .gemm_q                   = ggml_gemm_q4_0_q8_0,
+#endif
+#endif
+        },
+        [GGML_TYPE_Q4_1] = {
+            .dequantize_row_q         = dequantize_row_q4_1,
+            .quantize_row_q           = quantize_row_q4_1,
+            .quantize_row_q_reference = quantize_row_q4_1_reference,
+            .vec_dot_q                = ggml_vec_dot_q4_1_q8_1,
+            .vec_dot_type             = GGML_TYPE_Q8_1,
+#if defined(__AVX2__)
+            .gemm_q                   = ggml_gemm_q4_1_q8_1,
+#endif
+        },
+        [GGML_TYPE_Q5_0] = {
+            .dequantize_row_q         = dequantize_row_q5_0,
+            .quantize_row_q           = quantize_row_q5_0,
+            .quantize_row_q_reference = quantize_row_q5_0_reference,
+            .vec_dot_q                = ggml_vec_dot_q5_0_q8_0,
+            .vec_dot_type             = GGML_TYPE_Q8_0,
+#if defined(__AVX2__)
+            .gemm_q                   = ggml_gemm_q5_0_q8_0,
+#endif
+        },
+        [GGML_TYPE_Q8_0] = {
+            .dequantize_row_q         = dequantize_row_q8_0,
+            .quantize_row_q           = quantize_row_q8_0,
+            .quantize_row_q_reference = quantize_row_q8_0_reference,
+            .vec_dot_q                = ggml_vec_dot_q8_0_q8_0,
+            .vec_dot_type             = GGML_TYPE_Q8_0,
+#if defined(__AVX2__)
+            .gemm_q                   = ggml_gemm_q8_0_q8_0,
+#endif
+        },
+        [GGML_TYPE_Q8_1] = {
+            .quantize_row_q           = quantize_row_q8_1,
+            .quantize_row_q_reference = quantize_row_q8_1_reference,
+        },
+        [GGML_TYPE_BF16] = {
+            .dequantize_row_q         = dequantize_row_bf16,
+            .quantize_row_q           = quantize_row_bf16,
+            .quantize_row_q_reference = quantize_row_bf16_reference,
+            .vec_dot_q                = ggml_vec_dot_bf16,
+            .vec_dot_type             = GGML_TYPE_BF16,
+        },
+    },
+
+    .fp16_to_fp32_row = ggml_fp16_to_fp32_row,
+    .fp32_to_fp16_row = ggml_fp32_to_fp16_row,
+
+    .vec_dot_f32 = ggml_vec_dot_f32,
+    .vec_dot_f16 = ggml_vec_dot_f16,
+
+#if defined(GGML_SGEMM_MR)
+    .sgemm_mr     = GGML_SGEMM_MR,
+    .sgemm_nr     = GGML_SGEMM_NR,
+    .sgemm_kernel = ggml_sgemm_kernel,
+    .sgemm_pack_a = ggml_sgemm_pack_a,
+#endif
+};
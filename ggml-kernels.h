@@ -0,0 +1,172 @@
+#pragma once
+
+//
+// compute kernels
+//
+// internal to ggml: shared by ggml.c and ggml-kernels.c, not part of the public API
+//
+
+#include "ggml.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// if C99 - static_assert is noop
+// ref: https://stackoverflow.com/a/53923785/4039976
+#ifndef static_assert
+#define static_assert(cond, msg) struct global_scope_noop_trick
+#endif
+
+#define QK 32
+
+// floating point type used to accumulate sums
+typedef double ggml_float;
+
+// bf16 is the upper half of an fp32. the conversion from fp32 rounds to nearest even and keeps NaNs (quiet)
+static inline float ggml_compute_bf16_to_fp32(ggml_bf16_t h) {
+    union {
+        float    f;
+        uint32_t i;
+    } u;
+    u.i = (uint32_t) h << 16;
+    return u.f;
+}
+
+static inline ggml_bf16_t ggml_compute_fp32_to_bf16(float f) {
+    union {
+        float    f;
+        uint32_t i;
+    } u;
+    u.f = f;
+    if ((u.i & 0x7fffffff) > 0x7f800000) {
+        return (u.i >> 16) | 64;
+    }
+    return (u.i + (0x7fff + ((u.i >> 16) & 1))) >> 16;
+}
+
+#define GGML_BF16_TO_FP32(x) ggml_compute_bf16_to_fp32(x)
+#define GGML_FP32_TO_BF16(x) ggml_compute_fp32_to_bf16(x)
+
+// method 5
+// blocks of QK elements
+// represented with a single float (delta) and QK/2 8-bit ints (i.e QK 4-bit signed integer factors)
+typedef struct {
+    float   d; // delta
+    uint8_t qs[QK / 2]; // nibbles / quants
+} block_q4_0;
+static_assert(sizeof(block_q4_0) == sizeof(float) + QK / 2, "wrong q4_0 block size/padding");
+
+// method 4
+// blocks of QK elements
+// represented with 2 floats (delta + min) and QK/2 8-bit ints (i.e QK 4-bit unsigned integer factors)
+typedef struct {
+    float   d;
+    float   m;
+    uint8_t qs[QK / 2]; // nibbles / quants
+} block_q4_1;
+static_assert(sizeof(block_q4_1) == sizeof(float) * 2 + QK / 2, "wrong q4_1 block size/padding");
+
+// blocks of QK elements
+// represented with a single float (delta), the low 4 bits of QK 5-bit signed integer factors as nibbles
+// and their 5th bits packed in qh (bit l of the little-endian 32-bit int is the 5th bit of the l-th quant)
+typedef struct {
+    float   d; // delta
+    uint8_t qh[QK / 8]; // 5th bits of the quants
+    uint8_t qs[QK / 2]; // nibbles / quants
+} block_q5_0;
+static_assert(sizeof(block_q5_0) == sizeof(float) + QK / 8 + QK / 2, "wrong q5_0 block size/padding");
+
+// blocks of QK elements
+// represented with a single float (delta) and QK 8-bit ints (i.e QK 8-bit signed integer factors)
+// used to quantize the activations (src1) of the q4_0 dot products
+typedef struct {
+    float   d; // delta
+    int8_t  qs[QK]; // quants
+} block_q8_0;
+static_assert(sizeof(block_q8_0) == sizeof(float) + QK, "wrong q8_0 block size/padding");
+
+// same as block_q8_0, plus s = d*sum(qs) for the min term of the q4_1 dot products
+typedef struct {
+    float   d; // delta
+    float   s; // d * sum(qs[i])
+    int8_t  qs[QK]; // quants
+} block_q8_1;
+static_assert(sizeof(block_q8_1) == sizeof(float) * 2 + QK, "wrong q8_1 block size/padding");
+
+// quantized gemm micro-kernels
+// compute GGML_GEMM_MR x GGML_GEMM_NR dot products at once: MR rows of x (stride bx bytes) times NR rows of y
+// (stride by bytes), with the result of row r of x and row c of y in s[r + c*ss]
+// each unpacked block of x is reused NR times and each block of y MR times
+#define GGML_GEMM_MR 2
+#define GGML_GEMM_NR 4
+
+// the tiles are used from this many columns of src1 on
+#define GGML_GEMM_MIN_NE11 GGML_GEMM_NR
+
+// size of the blocks of columns of src1
+#define GGML_GEMM_L2_SIZE (256*1024)
+
+// packed sgemm, see ggml_compute_forward_mul_mat_sgemm in ggml.c
+// blocks of GGML_SGEMM_MC rows x GGML_SGEMM_KC values of src0 are packed into k-major panels of sgemm_mr rows
+#define GGML_SGEMM_KC 256
+#define GGML_SGEMM_MC 128
+
+static_assert(GGML_SGEMM_KC % QK == 0, "GGML_SGEMM_KC must be a multiple of QK");
+
+// the largest sgemm_mr x sgemm_nr tile of the tables
+#define GGML_SGEMM_TILE_MAX (32*12)
+
+typedef void (*dequantize_row_q_t)(const void * restrict x, float * restrict y, int k);
+typedef void (*quantize_row_q_t)(const float * restrict x, void * restrict y, int k);
+typedef void (*vec_dot_q_t)(const int n, float * restrict s, const void * restrict x, const void * restrict y);
+typedef void (*gemm_q_t)(const int n, float * restrict s, const int ss, const void * restrict x, const size_t bx, const void * restrict y, const size_t by);
+
+// c[r + j*ldc] (+)= sum_k a[k*MR + r]*b[k*NR + j] for r < MR and j < NR
+typedef void (*sgemm_kernel_t)(const int kc, const float * restrict a, const float * restrict b, float * restrict c, const int ldc, const bool add);
+// pack kc values of the mc rows of type at x (stride nb01 bytes) into panels of MR rows, pa[(r/MR)*MR*kc + k*MR + r%MR]
+typedef void (*sgemm_pack_a_t)(const enum ggml_type type, const char * x, const size_t nb01, int mc, int kc, float * restrict pa);
+
+typedef struct {
+    dequantize_row_q_t dequantize_row_q;
+    quantize_row_q_t   quantize_row_q;
+    quantize_row_q_t   quantize_row_q_reference; // deterministic, for the model files
+    vec_dot_q_t        vec_dot_q;
+    enum ggml_type     vec_dot_type; // the format src1 is quantized to for vec_dot_q
+    gemm_q_t           gemm_q;       // GGML_GEMM_MR x GGML_GEMM_NR tiles of vec_dot_q, optional
+} quantize_fns_t;
+
+// the kernels of one build of ggml-kernels.c
+struct ggml_kernels {
+    const char * name; // the instruction set they were compiled for
+
+    quantize_fns_t quantize_fns[GGML_TYPE_COUNT];
+
+    void (*fp16_to_fp32_row)(const ggml_fp16_t * restrict x, float * restrict y, int n);
+    void (*fp32_to_fp16_row)(const float * restrict x, ggml_fp16_t * restrict y, int n);
+
+    void (*vec_dot_f32)(const int n, float * restrict s, const float * restrict x, const float * restrict y);
+    void (*vec_dot_f16)(const int n, float * restrict s, ggml_fp16_t * restrict x, ggml_fp16_t * restrict y);
+
+    // packed sgemm micro-kernel and its MR x NR tile, NULL and 0 if the instruction set has none
+    int            sgemm_mr;
+    int            sgemm_nr;
+    sgemm_kernel_t sgemm_kernel;
+    sgemm_pack_a_t sgemm_pack_a;
+};
+
+// ggml-kernels.c compiled with the flags of the build (the baseline flags of the target with GGML_DISPATCH)
+extern const struct ggml_kernels ggml_kernels_base;
+
+#if defined(GGML_DISPATCH)
+// ggml-kernels.c compiled again for these x86 instruction sets (ggml-kernels-<name>.c), ggml_init() picks the best
+// one the CPU supports
+extern const struct ggml_kernels ggml_kernels_avx2;
+extern const struct ggml_kernels ggml_kernels_avx_vnni;
+extern const struct ggml_kernels ggml_kernels_avx512;
+extern const struct ggml_kernels ggml_kernels_avx512_vnni;
+extern const struct ggml_kernels ggml_kernels_avx512_bf16;
+#endif
+
+// the most builds of the kernels a CPU can support: the base one and the GGML_DISPATCH ones
+#define GGML_KERNELS_MAX 6
@@ -194,17 +194,31 @@ typedef uint16_t ggml_fp16_t;
 float       ggml_fp16_to_fp32(ggml_fp16_t x);
 ggml_fp16_t ggml_fp32_to_fp16(float x);
 
+// bfloat16: the upper 16 bits of an FP32
+typedef uint16_t ggml_bf16_t;
+
+// convert BF16 <-> FP32, rounding to nearest even
+float       ggml_bf16_to_fp32(ggml_bf16_t x);
+ggml_bf16_t ggml_fp32_to_bf16(float x);
+
+// y = softmax(x) over n values, -INFINITY gives 0. y can be x
+void ggml_soft_max_f32_row(const float * x, float * y, int n);
+
 struct ggml_object;
 struct ggml_context;
 
 enum ggml_type {
     GGML_TYPE_Q4_0,
     GGML_TYPE_Q4_1,
+    GGML_TYPE_Q5_0,
+    GGML_TYPE_Q8_0,
+    GGML_TYPE_Q8_1,
     GGML_TYPE_I8,
     GGML_TYPE_I16,
     GGML_TYPE_I32,
     GGML_TYPE_F16,
     GGML_TYPE_F32,
+    GGML_TYPE_BF16,
     GGML_TYPE_COUNT,
 };
 
@@ -286,12 +300,16 @@ struct ggml_tensor {
     char padding[8];
 };
 
+struct ggml_threadpool;
+
 // computation graph
 struct ggml_cgraph {
     int n_nodes;
     int n_leafs;
     int n_threads;
 
+    struct ggml_threadpool * threadpool; // optional, see ggml_threadpool_new()
+
     size_t work_size;
     struct ggml_tensor * work;
 
@@ -410,6 +428,11 @@ struct ggml_tensor * ggml_add(
         struct ggml_tensor  * a,
         struct ggml_tensor  * b);
 
+struct ggml_tensor * ggml_add_inplace(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b);
+
 struct ggml_tensor * ggml_sub(
         struct ggml_context * ctx,
         struct ggml_tensor  * a,
@@ -594,6 +617,15 @@ struct ggml_tensor * ggml_rope(
         int                   n_dims,
         int                   mode);
 
+// rotary position embedding with an explicit position for each index along dim 2
+// b is an I32 tensor with a->ne[2] elements
+// in-place, returns view(a)
+struct ggml_tensor * ggml_rope_pos(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b,
+        int                   n_dims);
+
 // padding = 1
 // TODO: we don't support extra parameters for now
 //       that's why we are hard-coding the stride, padding, and dilation
@@ -636,6 +668,57 @@ void ggml_build_forward_expand(struct ggml_cgraph * cgraph, struct ggml_tensor *
 struct ggml_cgraph ggml_build_forward (struct ggml_tensor * tensor);
 struct ggml_cgraph ggml_build_backward(struct ggml_context * ctx, struct ggml_cgraph * gf, bool keep);
 
+// NUMA
+//
+// ggml_numa_init() reads the NUMA topology from sysfs (Linux only) and returns the number of nodes.
+// on a multi-node system, the thread pools created afterwards spread their threads evenly over the nodes,
+// and ggml_numa_distribute() moves the rows of a weight matrix to the node whose threads compute them in ggml_mul_mat()
+//
+int  ggml_numa_init(void);
+bool ggml_is_numa(void);
+void ggml_numa_distribute(struct ggml_tensor * tensor);
+
+// cpu sets
+//
+// ggml_cpu_select() resolves a cpu set for ggml_threadpool_new_cpus() and returns the number of cpus written
+// to cpus (at most n_max), or -1 if the spec is invalid or not supported on this system. spec is one of:
+//
+//   "0-7,16"   - an explicit list of cpu ids
+//   "physical" - one cpu per physical core (no SMT siblings)
+//   "l2"       - one cpu per L2 cache
+//   "numa:N"   - the cpus of NUMA node N
+//
+int ggml_cpu_select(const char * spec, int * cpus, int n_max);
+
+// thread pool
+//
+// keeps n_threads - 1 worker threads alive across ggml_graph_compute() calls - set cgraph->threadpool to use it
+// if cgraph->threadpool is NULL or its size does not match cgraph->n_threads, temporary threads are created per call
+//
+// spin_us: how long a waiting thread (an idle worker, or the main thread waiting for the workers) busy-waits
+//          before it parks on a futex / condition variable (0 - park right away, < 0 - never park)
+//
+// ggml_threadpool_new_cpus() pins thread i (the thread calling ggml_graph_compute() is thread 0) to cpus[i % n_cpus]
+// instead of spreading the threads over the NUMA nodes
+//
+struct ggml_threadpool * ggml_threadpool_new     (int n_threads, int spin_us);
+struct ggml_threadpool * ggml_threadpool_new_cpus(int n_threads, int spin_us, const int * cpus, int n_cpus);
+void                     ggml_threadpool_free    (struct ggml_threadpool * pool);
+
+int ggml_threadpool_n_threads(const struct ggml_threadpool * pool);
+
+// synchronization stats, summed over all threads of the pool
+struct ggml_threadpool_stats {
+    int64_t n_wait;        // number of waits
+    int64_t n_park;        // number of waits that had to park
+    int64_t t_wake_us;     // total time from the signal to the wake-up of the parked threads
+    int64_t t_wake_max_us;
+};
+
+// only call these while no graph is being computed with the pool
+void ggml_threadpool_get_stats  (const struct ggml_threadpool * pool, struct ggml_threadpool_stats * stats);
+void ggml_threadpool_reset_stats(      struct ggml_threadpool * pool);
+
 void ggml_graph_compute(struct ggml_context * ctx, struct ggml_cgraph * cgraph);
 void ggml_graph_reset  (struct ggml_cgraph * cgraph);
 
@@ -750,11 +833,24 @@ enum ggml_opt_result ggml_opt(
 
 size_t ggml_quantize_q4_0(const float * src, void * dst, int n, int k, int64_t * hist);
 size_t ggml_quantize_q4_1(const float * src, void * dst, int n, int k, int64_t * hist);
+size_t ggml_quantize_q5_0(const float * src, void * dst, int n, int k, int64_t * hist);
+size_t ggml_quantize_q8_0(const float * src, void * dst, int n, int k, int64_t * hist);
 
 //
 // system info
 //
 
+// the instruction set of the kernels in use, chosen at run time when built with GGML_DISPATCH
+const char * ggml_cpu_kernels(void);
+
+// the instruction set of the i-th build of the kernels that this CPU supports, the fastest first, or NULL past the last
+// one. without GGML_DISPATCH there is only the one the library was built for
+const char * ggml_cpu_kernels_supported(int i);
+
+// use the build of the kernels with that instruction set instead of the fastest one, mostly for testing
+// call it while no graph is being computed. returns false if the CPU does not support it
+bool ggml_cpu_kernels_set(const char * name);
+
 int ggml_cpu_has_avx(void);
 int ggml_cpu_has_avx2(void);
 int ggml_cpu_has_avx512(void);
@@ -6,15 +6,30 @@
 #include <fstream>
 #include <random>
 #include <map>
+#include <set>
 #include <unordered_map>
 #include <queue>
 #include <regex>
 #include <cassert>
 #include <cstring>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define LLAMA_USE_SCRATCH
 #define LLAMA_MAX_SCRATCH_BUFFERS 16
 
+// how long the idle eval threads spin between calls before they block
+#define LLAMA_THREADPOOL_SPIN_US 2000
+
+// maximum size of the cpu set the eval threads are pinned to
+#define LLAMA_MAX_CPUS 512
+
+// batches up to this size count as decoding for the shared pool and go ahead of prompt processing
+#define LLAMA_SCHED_DECODE_MAX_TOKENS 16
+
 #define LLAMA_ASSERT(x) \
     do { \
         if (!(x)) { \
@@ -69,7 +84,8 @@ static const std::map<e_model, size_t> MEM_REQ_KV_SELF = {
     { MODEL_65B,  5120ull*MB },
 };
 
-// this is mostly needed for temporary mul_mat buffers to dequantize the data
+// this is mostly needed for temporary mul_mat buffers to convert the data
+// with BLAS, the f16 weights are converted to a full f32 copy; the quantized ones are dequantized in small tiles
 // not actually needed if BLAS is disabled
 static const std::map<e_model, size_t> MEM_REQ_EVAL = {
     { MODEL_7B,   768ull*MB },
@@ -109,10 +125,18 @@ struct llama_layer {
     struct ggml_tensor * w3;
 };
 
+struct llama_kv_cell {
+    int pos    = -1; // position of the token in its sequence, -1 if the cell is free
+    int seq_id = -1; // sequence the token belongs to
+};
+
 struct llama_kv_cache {
     struct ggml_tensor * k;
     struct ggml_tensor * v;
 
+    // one cell per slot of the cache, shared by all sequences
+    std::vector<llama_kv_cell> cells;
+
     struct ggml_context * ctx;
 
     std::vector<uint8_t> buf;
@@ -160,6 +184,32 @@ struct llama_vocab {
     std::vector<token_score> id_to_token;
 };
 
+// background thread of a context that runs the asynchronous evaluations, one at a time
+struct llama_eval_worker {
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    std::function<int()>     job;  // next evaluation to run
+    std::function<void(int)> done; // completion callback of the next evaluation
+
+    bool pending = false; // an evaluation was submitted and is not done yet
+    bool busy    = false; // a synchronous call is using the context
+    bool exit    = false;
+    int  result  = 0;     // result of the last evaluation
+};
+
+// running pooling of the token embeddings of a sequence (embedding mode), over the evaluations since its tokens
+// were last removed from the KV cache
+struct llama_seq_pooling {
+    std::vector<float> acc;    // sum (mean), maximum (max) or embedding of the last position (last)
+    int n_tokens = 0;
+    int last_pos = -1;
+
+    std::vector<float> pooled; // [n_embd]
+};
+
 struct llama_context {
     std::mt19937 rng;
 
@@ -171,9 +221,12 @@ struct llama_context {
     int64_t t_p_eval_us = 0;
 
     int32_t n_sample = 0; // number of tokens sampled
-    int32_t n_eval   = 0; // number of eval calls
+    int32_t n_eval   = 0; // number of eval calls (one per sequence for a batch with one token per sequence)
     int32_t n_p_eval = 0; // number of tokens in eval calls for the prompt (with batch size > 1)
 
+    int32_t n_draft  = 0; // number of tokens proposed by a draft model (speculative decoding)
+    int32_t n_accept = 0; // number of drafted tokens that were accepted
+
     llama_model model;
     llama_vocab vocab;
 
@@ -183,9 +236,38 @@ struct llama_context {
     std::vector<float> logits;
     bool logits_all = false;
 
-    // input embedding (1-dimensional array: [n_embd])
+    // if not empty, the logits are computed only for these tokens ([n_tokens][vocab_subset.size()])
+    std::vector<llama_vocab::id> vocab_subset;
+
+    // embedding mode: the lm_head is skipped and the final hidden states are returned instead of the logits
+    bool embedding_mode = false;
+    llama_pooling_type pooling = LLAMA_POOLING_LAST;
+
+    // per-token embeddings (2-dimensional array: [n_tokens][n_embd])
+    std::vector<float> embedding_tokens;
+
+    // pooled embeddings of each sequence in the KV cache
+    std::map<int, llama_seq_pooling> embedding_seq;
+
+    // pooled input embedding of the sequence of the last token (1-dimensional array: [n_embd])
     std::vector<float> embedding;
 
+    // eval threads, kept alive between calls and recreated when the number of threads changes
+    struct ggml_threadpool * threadpool = nullptr;
+
+    // cpus the eval threads are pinned to (empty - no pinning)
+    std::vector<int> cpus;
+
+    // asynchronous evaluations, see llama_eval_async()
+    llama_eval_worker eval_worker;
+
+    // scheduling on the shared pool, see llama_init_shared_pool()
+    int priority = 0;
+
+    int64_t t_queue_us     = 0; // time the graphs waited for the shared pool
+    int64_t t_queue_max_us = 0;
+    int32_t n_queue        = 0; // number of graphs computed on the shared pool
+
     // memory buffers used to evaluate the model
     // TODO: move in llama_state
     std::vector<uint8_t> buf_compute;
@@ -226,6 +308,14 @@ struct llama_context {
     }
 };
 
+// make the next tensor allocated in ctx use buf for its data, so that the result does not have to be copied out
+// (the size is padded the same way the allocator pads the tensor data)
+static void llama_set_output(struct ggml_context * ctx, std::vector<float> & buf) {
+    const size_t size = sizeof(float)*buf.size();
+
+    ggml_set_scratch(ctx, { 0, ((size + 15)/16)*16, buf.data(), });
+}
+
 //
 // kv cache
 //
@@ -257,9 +347,36 @@ static bool kv_cache_init(
     cache.k = ggml_new_tensor_1d(cache.ctx, wtype, n_elements);
     cache.v = ggml_new_tensor_1d(cache.ctx, wtype, n_elements);
 
+    cache.cells.assign(n_ctx, llama_kv_cell());
+
     return true;
 }
 
+// find a run of n free cells, returns the index of the first one or -1 if there is none
+static int kv_cache_find_slot(const struct llama_kv_cache & cache, int n) {
+    const int n_ctx = cache.cells.size();
+
+    int n_free = 0;
+    for (int i = 0; i < n_ctx; ++i) {
+        n_free = cache.cells[i].pos < 0 ? n_free + 1 : 0;
+        if (n_free == n) {
+            return i - n + 1;
+        }
+    }
+
+    return -1;
+}
+
+// free the cells of sequence seq_id (any sequence if seq_id < 0) with position >= p0
+static void kv_cache_seq_rm(struct llama_kv_cache & cache, int seq_id, int p0) {
+    for (auto & cell : cache.cells) {
+        if (cell.pos >= p0 && (seq_id < 0 || cell.seq_id == seq_id)) {
+            cell.pos    = -1;
+            cell.seq_id = -1;
+        }
+    }
+}
+
 static void kv_cache_free(struct llama_kv_cache & cache) {
     if (cache.ctx) {
         ggml_free(cache.ctx);
@@ -276,7 +393,11 @@ struct llama_context_params llama_context_default_params() {
         /*.logits_all                  =*/ false,
         /*.vocab_only                  =*/ false,
         /*.use_mlock                   =*/ false,
+        /*.numa                        =*/ false,
+        /*.cpus                        =*/ nullptr,
+        /*.priority                    =*/ 0,
         /*.embedding                   =*/ false,
+        /*.pooling                     =*/ LLAMA_POOLING_LAST,
         /*.progress_callback           =*/ nullptr,
         /*.progress_callback_user_data =*/ nullptr,
     };
@@ -441,6 +562,9 @@ static bool llama_model_load(
         case 2: wtype = vtype = GGML_TYPE_Q4_0; break;
         case 3: wtype = vtype = GGML_TYPE_Q4_1; break;
         case 4: wtype = GGML_TYPE_Q4_1; vtype = GGML_TYPE_F16; break;
+        case 5: wtype = vtype = GGML_TYPE_Q5_0; break;
+        case 6: wtype = vtype = GGML_TYPE_Q8_0; break;
+        case 7: wtype = vtype = GGML_TYPE_BF16; break;
         default:
                 {
                     fprintf(stderr, "%s: invalid model file '%s' (bad f16 value %d)\n",
@@ -710,7 +834,7 @@ static bool llama_model_load(
                 }
 
                 if (0) {
-                    static const char * ftype_str[] = { "f32", "f16", "q4_0", "q4_1", };
+                    static const char * ftype_str[] = { "f32", "f16", "q4_0", "q4_1", "", "q5_0", "q8_0", "bf16", };
                     fprintf(stderr, "%24s - [%5d, %5d], type = %6s, split = %d\n", name.data(), ne[0], ne[1], ftype_str[ftype], split_type);
                 }
 
@@ -721,6 +845,9 @@ static bool llama_model_load(
                     case 1: bpe = ggml_type_size(GGML_TYPE_F16);  break;
                     case 2: bpe = ggml_type_size(GGML_TYPE_Q4_0); assert(ne[0] % 64 == 0); break;
                     case 3: bpe = ggml_type_size(GGML_TYPE_Q4_1); assert(ne[0] % 64 == 0); break;
+                    case 5: bpe = ggml_type_size(GGML_TYPE_Q5_0); assert(ne[0] % 32 == 0); break;
+                    case 6: bpe = ggml_type_size(GGML_TYPE_Q8_0); assert(ne[0] % 32 == 0); break;
+                    case 7: bpe = ggml_type_size(GGML_TYPE_BF16); break;
                     default:
                             {
                                 fprintf(stderr, "%s: unknown ftype %d in model file\n", __func__, ftype);
@@ -812,27 +939,154 @@ static bool llama_model_load(
     return true;
 }
 
+//
+// shared pool
+//
+// the graphs of all contexts are computed one at a time on a single pool that uses all threads of the budget.
+// waiting graphs are ordered by priority, then decode ahead of prompt processing, then in order of arrival
+//
+
+struct llama_sched_ticket {
+    int      priority;
+    bool     decode;
+    uint64_t seq;
+
+    // std::priority_queue pops the largest element first
+    bool operator<(const llama_sched_ticket & other) const {
+        if (priority != other.priority) {
+            return priority < other.priority;
+        }
+        if (decode != other.decode) {
+            return !decode;
+        }
+        return seq > other.seq;
+    }
+};
+
+static struct llama_sched {
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    struct ggml_threadpool * pool = nullptr;
+
+    int  n_threads = 0;
+    bool busy      = false; // a graph is being computed on the pool
+
+    uint64_t seq = 0;
+    std::priority_queue<llama_sched_ticket> queue;
+} g_sched;
+
+static bool llama_sched_enabled() {
+    std::lock_guard<std::mutex> lock(g_sched.mutex);
+
+    return g_sched.pool != nullptr;
+}
+
+// wait for the turn of the graph on the shared pool and set it up to use the pool
+// returns false if there is no shared pool
+static bool llama_sched_acquire(llama_context & lctx, int n_tokens, ggml_cgraph & gf) {
+    const int64_t t_start_us = ggml_time_us();
+
+    std::unique_lock<std::mutex> lock(g_sched.mutex);
+
+    if (g_sched.pool == nullptr) {
+        return false;
+    }
+
+    const llama_sched_ticket ticket = { lctx.priority, n_tokens <= LLAMA_SCHED_DECODE_MAX_TOKENS, g_sched.seq++ };
+
+    g_sched.queue.push(ticket);
+    g_sched.cv.wait(lock, [&] { return !g_sched.busy && g_sched.queue.top().seq == ticket.seq; });
+    g_sched.queue.pop();
+    g_sched.busy = true;
+
+    // single-threaded graphs still wait for their turn
+    if (gf.n_threads > 1) {
+        gf.n_threads  = g_sched.n_threads;
+        gf.threadpool = g_sched.pool;
+    }
+
+    const int64_t t_queue_us = ggml_time_us() - t_start_us;
+
+    lctx.t_queue_us    += t_queue_us;
+    lctx.t_queue_max_us = std::max(lctx.t_queue_max_us, t_queue_us);
+    lctx.n_queue++;
+
+    return true;
+}
+
+static void llama_sched_release() {
+    std::lock_guard<std::mutex> lock(g_sched.mutex);
+
+    g_sched.busy = false;
+    g_sched.cv.notify_all();
+}
+
+int llama_init_shared_pool(int n_threads, const char * cpus) {
+    std::vector<int> cpu_set;
+
+    if (cpus != nullptr) {
+        cpu_set.resize(LLAMA_MAX_CPUS);
+
+        const int n_cpus = ggml_cpu_select(cpus, cpu_set.data(), cpu_set.size());
+        if (n_cpus <= 0) {
+            fprintf(stderr, "%s: invalid or unsupported cpu set '%s'\n", __func__, cpus);
+            return 1;
+        }
+
+        cpu_set.resize(n_cpus);
+    }
+
+    std::lock_guard<std::mutex> lock(g_sched.mutex);
+
+    if (g_sched.pool != nullptr) {
+        fprintf(stderr, "%s: the shared pool is already initialized\n", __func__);
+        return 1;
+    }
+
+    g_sched.n_threads = std::max(1, n_threads);
+    g_sched.pool      = ggml_threadpool_new_cpus(g_sched.n_threads, LLAMA_THREADPOOL_SPIN_US, cpu_set.data(), cpu_set.size());
+
+    return 0;
+}
+
+void llama_free_shared_pool(void) {
+    std::unique_lock<std::mutex> lock(g_sched.mutex);
+
+    g_sched.cv.wait(lock, [] { return !g_sched.busy && g_sched.queue.empty(); });
+
+    ggml_threadpool_free(g_sched.pool);
+
+    g_sched.pool      = nullptr;
+    g_sched.n_threads = 0;
+}
+
 // evaluate the transformer
 //
 //   - lctx:      llama context
 //   - tokens:    new batch of tokens to process
-//   - n_past:    the context size so far
+//   - pos:       position of each token within its sequence
+//   - seq_id:    sequence of each token - a token attends only to the cached tokens of its own sequence
 //   - n_threads: number of threads to use
+//   - out_ids:   indices of the tokens in the batch for which to compute logits (ascending)
 //
 static bool llama_eval_internal(
         llama_context & lctx,
     const llama_token * tokens,
+            const int * pos,
+            const int * seq_id,
             const int   n_tokens,
-            const int   n_past,
-            const int   n_threads) {
+            const int   n_threads,
+    const std::vector<int> & out_ids) {
     const int64_t t_start_us = ggml_time_us();
 
-    const int N = n_tokens;
+    const int N     = n_tokens;
+    const int n_out = out_ids.size();
 
     const auto & model   = lctx.model;
     const auto & hparams = model.hparams;
 
-    auto & kv_self = model.kv_self;
+    auto & kv_self = lctx.model.kv_self;
 
     LLAMA_ASSERT(!!kv_self.ctx);
 
@@ -843,6 +1097,35 @@ static bool llama_eval_internal(
     const int n_vocab = hparams.n_vocab;
     const int n_rot   = hparams.n_embd/hparams.n_head;
 
+    // a cell with a negative position is free, so the batch is checked before any cell is used
+    for (int i = 0; i < N; ++i) {
+        if (pos[i] < 0 || pos[i] >= n_ctx || seq_id[i] < 0) {
+            fprintf(stderr, "%s: invalid token %d of the batch (pos = %d, seq_id = %d, n_ctx = %d)\n", __func__, i, pos[i], seq_id[i], n_ctx);
+            return false;
+        }
+    }
+
+    // the batch is stored in a contiguous run of free cells of the KV cache
+    const int slot = kv_cache_find_slot(kv_self, N);
+    if (slot < 0) {
+        fprintf(stderr, "%s: not enough free space in the KV cache for a batch of %d tokens\n", __func__, N);
+        return false;
+    }
+
+    for (int i = 0; i < N; ++i) {
+        kv_self.cells[slot + i].pos    = pos[i];
+        kv_self.cells[slot + i].seq_id = seq_id[i];
+    }
+
+    // the attention only has to look at the cells up to the last used one
+    int n_kv = slot + N;
+    for (int i = n_ctx - 1; i >= n_kv; --i) {
+        if (kv_self.cells[i].pos >= 0) {
+            n_kv = i + 1;
+            break;
+        }
+    }
+
     auto & mem_per_token = lctx.mem_per_token;
     auto & buf_compute   = lctx.buf_compute;
 
@@ -853,16 +1136,61 @@ static bool llama_eval_internal(
 
     struct ggml_context * ctx0 = ggml_init(params);
 
-    // for big prompts, if BLAS is enabled, it is better to use only one thread
-    // otherwise, the threads are spin-lock waiting for the BLAS calls and are degrading the performance
+    // the number of threads of each node is sized by ggml_graph_compute() - the BLAS matrix multiplications run on
+    // one thread while the idle workers park
     ggml_cgraph gf = {};
-    gf.n_threads = N > 255 && ggml_cpu_has_blas() ? 1 : n_threads;
+    gf.n_threads = n_threads;
+
+    // with a shared pool, the threads are set up once the graph gets its turn (see llama_sched_acquire())
+    if (gf.n_threads > 1 && !llama_sched_enabled()) {
+        if (lctx.threadpool == nullptr || ggml_threadpool_n_threads(lctx.threadpool) != gf.n_threads) {
+            ggml_threadpool_free(lctx.threadpool);
+            lctx.threadpool = ggml_threadpool_new_cpus(gf.n_threads, LLAMA_THREADPOOL_SPIN_US, lctx.cpus.data(), lctx.cpus.size());
+
+            if (gf.n_threads > (int) lctx.cpus.size() && !lctx.cpus.empty()) {
+                fprintf(stderr, "%s: warning: %d threads share %d cpus\n", __func__, gf.n_threads, (int) lctx.cpus.size());
+            }
+        }
+        gf.threadpool = lctx.threadpool;
+    }
 
     struct ggml_tensor * embd = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, N);
     memcpy(embd->data, tokens, N*ggml_element_size(embd));
 
     struct ggml_tensor * inpL = ggml_get_rows(ctx0, model.tok_embeddings, embd);
 
+    struct ggml_tensor * inp_pos = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, N);
+    memcpy(inp_pos->data, pos, N*ggml_element_size(inp_pos));
+
+    // KQ_mask[i][j] = 0 if token i attends to cell j, -INFINITY otherwise (added to every head)
+    struct ggml_tensor * KQ_mask = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_kv, N);
+    {
+        float * data = (float *) KQ_mask->data;
+
+        for (int i = 0; i < N; ++i) {
+            for (int j = 0; j < n_kv; ++j) {
+                const auto & cell = kv_self.cells[j];
+                data[i*n_kv + j] = cell.seq_id == seq_id[i] && cell.pos >= 0 && cell.pos <= pos[i] ? 0.0f : -INFINITY;
+            }
+        }
+    }
+
+    // rows of the hidden state that are fed to the lm_head
+    struct ggml_tensor * inp_out = NULL;
+    if (n_out > 0 && n_out < N) {
+        inp_out = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, n_out);
+        memcpy(inp_out->data, out_ids.data(), n_out*ggml_element_size(inp_out));
+    }
+
+    // rows of the output matrix to use for the logits
+    const int n_logits = lctx.vocab_subset.empty() ? n_vocab : lctx.vocab_subset.size();
+
+    struct ggml_tensor * inp_vocab = NULL;
+    if (n_logits < n_vocab) {
+        inp_vocab = ggml_new_tensor_1d(ctx0, GGML_TYPE_I32, n_logits);
+        memcpy(inp_vocab->data, lctx.vocab_subset.data(), n_logits*ggml_element_size(inp_vocab));
+    }
+
     for (int il = 0; il < n_layer; ++il) {
         struct ggml_tensor * inpSA = inpL;
 
@@ -886,33 +1214,34 @@ static bool llama_eval_internal(
             struct ggml_tensor * Kcur = ggml_mul_mat(ctx0, model.layers[il].wk, cur);
             struct ggml_tensor * Vcur = ggml_mul_mat(ctx0, model.layers[il].wv, cur);
 
-            // store key and value to memory
-            if (N >= 1) {
-                struct ggml_tensor * k = ggml_view_1d(ctx0, kv_self.k, N*n_embd, (ggml_element_size(kv_self.k)*n_embd)*(il*n_ctx + n_past));
-                struct ggml_tensor * v = ggml_view_1d(ctx0, kv_self.v, N*n_embd, (ggml_element_size(kv_self.v)*n_embd)*(il*n_ctx + n_past));
-
-                ggml_build_forward_expand(&gf, ggml_cpy(ctx0, Kcur, k));
-                ggml_build_forward_expand(&gf, ggml_cpy(ctx0, Vcur, v));
-            }
-
-            // Q = Qcur.contiguous().view(n_embd/n_head, n_head, N).permute(0, 2, 1, 3)
+            // Q = rope(Qcur.view(n_embd/n_head, n_head, N)).permute(0, 2, 1, 3)
             struct ggml_tensor * Q =
                 ggml_permute(ctx0,
-                        ggml_rope(ctx0,
-                            ggml_cpy(ctx0,
-                                Qcur,
-                                ggml_new_tensor_3d(ctx0, GGML_TYPE_F32, n_embd/n_head, n_head, N)),
-                            n_past, n_rot, 0),
+                        ggml_rope_pos(ctx0,
+                            ggml_reshape_3d(ctx0, Qcur, n_embd/n_head, n_head, N),
+                            inp_pos, n_rot),
                         0, 2, 1, 3);
 
-            // K = Kmem.view(n_embd/n_head, n_head, n_past + N).permute(0, 2, 1, 3)
+            // store the rotated key and the value to memory
+            {
+                struct ggml_tensor * Krot =
+                    ggml_rope_pos(ctx0,
+                            ggml_reshape_3d(ctx0, Kcur, n_embd/n_head, n_head, N),
+                            inp_pos, n_rot);
+
+                struct ggml_tensor * k = ggml_view_1d(ctx0, kv_self.k, N*n_embd, (ggml_element_size(kv_self.k)*n_embd)*(il*n_ctx + slot));
+                struct ggml_tensor * v = ggml_view_1d(ctx0, kv_self.v, N*n_embd, (ggml_element_size(kv_self.v)*n_embd)*(il*n_ctx + slot));
+
+                ggml_build_forward_expand(&gf, ggml_cpy(ctx0, Krot, k));
+                ggml_build_forward_expand(&gf, ggml_cpy(ctx0, Vcur, v));
+            }
+
+            // K = Kmem.view(n_embd/n_head, n_head, n_kv).permute(0, 2, 1, 3)
             struct ggml_tensor * K =
                 ggml_permute(ctx0,
-                        ggml_rope(ctx0,
-                            ggml_reshape_3d(ctx0,
-                                ggml_view_1d(ctx0, kv_self.k, (n_past + N)*n_embd, il*n_ctx*ggml_element_size(kv_self.k)*n_embd),
-                                n_embd/n_head, n_head, n_past + N),
-                            n_past, n_rot, 1),
+                        ggml_reshape_3d(ctx0,
+                            ggml_view_1d(ctx0, kv_self.k, n_kv*n_embd, il*n_ctx*ggml_element_size(kv_self.k)*n_embd),
+                            n_embd/n_head, n_head, n_kv),
                         0, 2, 1, 3);
 
             // K * Q
@@ -924,21 +1253,21 @@ static bool llama_eval_internal(
                         KQ,
                         ggml_new_f32(ctx0, 1.0f/sqrtf(float(n_embd)/n_head)));
 
-            // KQ_masked = mask_past(KQ_scaled)
-            struct ggml_tensor * KQ_masked = ggml_diag_mask_inf(ctx0, KQ_scaled, n_past);
+            // KQ_masked = KQ_scaled + KQ_mask (other sequences and future positions)
+            struct ggml_tensor * KQ_masked = ggml_add_inplace(ctx0, KQ_scaled, KQ_mask);
 
             // KQ = soft_max(KQ_masked)
             struct ggml_tensor * KQ_soft_max = ggml_soft_max(ctx0, KQ_masked);
 
-            // V_trans = Vmem.view(n_embd/n_head, n_head, n_past + N).permute(1, 2, 0, 3).contiguous()
+            // V_trans = Vmem.view(n_embd/n_head, n_head, n_kv).permute(1, 2, 0, 3).contiguous()
             struct ggml_tensor * V_trans =
                 ggml_cpy(ctx0,
                     ggml_permute(ctx0,
                             ggml_reshape_3d(ctx0,
-                                ggml_view_1d(ctx0, kv_self.v, (n_past + N)*n_embd, il*n_ctx*ggml_element_size(kv_self.v)*n_embd),
-                                n_embd/n_head, n_head, n_past + N),
+                                ggml_view_1d(ctx0, kv_self.v, n_kv*n_embd, il*n_ctx*ggml_element_size(kv_self.v)*n_embd),
+                                n_embd/n_head, n_head, n_kv),
                             1, 2, 0, 3),
-                    ggml_new_tensor_3d(ctx0, kv_self.v->type, n_past + N, n_embd/n_head, n_head));
+                    ggml_new_tensor_3d(ctx0, kv_self.v->type, n_kv, n_embd/n_head, n_head));
 
             // KQV = transpose(V) * KQ_soft_max
             struct ggml_tensor * KQV = ggml_mul_mat(ctx0, V_trans, KQ_soft_max);
@@ -999,62 +1328,135 @@ static bool llama_eval_internal(
 
     lctx.use_buf(ctx0, 0);
 
-    // used at the end to optionally extract the embeddings
-    struct ggml_tensor * embeddings = NULL;
+    // in embedding mode, the lm_head is skipped and the normalized hidden states are the output
+    const bool embd_mode = lctx.embedding_mode;
 
-    // norm
-    {
+    auto & logits_out = lctx.logits;
+    auto & embd_out   = lctx.embedding_tokens;
 
+    logits_out.resize(embd_mode ? 0 : n_logits*n_out);
+    embd_out.resize(embd_mode ? n_embd*N : 0);
+
+    if (embd_mode) {
+        // norm
         inpL = ggml_rms_norm(ctx0, inpL);
 
-        // inpL = norm*inpL
-        inpL = ggml_mul(ctx0,
-                    ggml_repeat(ctx0, model.norm, inpL),
-                    inpL);
+        struct ggml_tensor * norm = ggml_repeat(ctx0, model.norm, inpL);
 
-        embeddings = inpL;
-    }
+        lctx.use_buf(ctx0, -1);
+
+        // inpL = norm*inpL, written directly into the per-token embeddings
+        llama_set_output(ctx0, embd_out);
+        inpL = ggml_mul(ctx0, norm, inpL);
+        ggml_set_scratch(ctx0, { 0, 0, nullptr, });
 
-    // lm_head
-    inpL = ggml_mul_mat(ctx0, model.output, inpL);
+        LLAMA_ASSERT(ggml_get_data(inpL) == embd_out.data());
 
-    lctx.use_buf(ctx0, -1);
+        ggml_build_forward_expand(&gf, inpL);
+    } else if (n_out > 0) {
+        // the rms norm is per row, so the unused rows can be dropped before it
+        if (inp_out) {
+            inpL = ggml_get_rows(ctx0, inpL, inp_out);
+        }
+
+        // norm
+        {
+            inpL = ggml_rms_norm(ctx0, inpL);
+
+            // inpL = norm*inpL
+            inpL = ggml_mul(ctx0,
+                        ggml_repeat(ctx0, model.norm, inpL),
+                        inpL);
+        }
+
+        lctx.use_buf(ctx0, -1);
+
+        // for a subset of the vocabulary, only the corresponding rows of the lm_head are used
+        struct ggml_tensor * output = model.output;
+        if (inp_vocab) {
+            output = ggml_get_rows(ctx0, output, inp_vocab);
+        }
+
+        // lm_head, written directly into the logits
+        llama_set_output(ctx0, logits_out);
+        inpL = ggml_mul_mat(ctx0, output, inpL);
+        ggml_set_scratch(ctx0, { 0, 0, nullptr, });
+
+        LLAMA_ASSERT(ggml_get_data(inpL) == logits_out.data());
+
+        ggml_build_forward_expand(&gf, inpL);
+    } else {
+        lctx.use_buf(ctx0, -1);
+    }
 
     // logits -> probs
     //inpL = ggml_soft_max(ctx0, inpL);
 
     // run the computation
-    ggml_build_forward_expand(&gf, inpL);
-    ggml_graph_compute       (ctx0, &gf);
+    const bool shared = llama_sched_acquire(lctx, N, gf);
+
+    ggml_graph_compute(ctx0, &gf);
+
+    if (shared) {
+        llama_sched_release();
+    }
 
     //if (n_past%100 == 0) {
     //    ggml_graph_print   (&gf);
     //    ggml_graph_dump_dot(&gf, NULL, "gpt-2.dot");
     //}
 
-    //embd_w.resize(n_vocab*N);
-    //memcpy(embd_w.data(), ggml_get_data(inpL), sizeof(float)*n_vocab*N);
+    // pool the embeddings of the tokens of each sequence
+    if (embd_mode) {
+        auto & embd_seq = lctx.embedding_seq;
 
-    // extract logits
-    {
-        auto & logits_out = lctx.logits;
+        // the pooling of a sequence continues over the batches that extend it
+        for (int i = 0; i < N; ++i) {
+            const float * embd = embd_out.data() + i*n_embd;
 
-        if (lctx.logits_all) {
-            logits_out.resize(n_vocab * N);
-            memcpy(logits_out.data(), (float *) ggml_get_data(inpL), sizeof(float)*n_vocab*N);
-        } else {
-            // return result for just the last token
-            logits_out.resize(n_vocab);
-            memcpy(logits_out.data(), (float *) ggml_get_data(inpL) + (n_vocab*(N-1)), sizeof(float)*n_vocab);
+            auto & sp = embd_seq[seq_id[i]];
+
+            if (sp.n_tokens == 0) {
+                sp.acc.assign(embd, embd + n_embd);
+            } else {
+                switch (lctx.pooling) {
+                    case LLAMA_POOLING_LAST:
+                        if (pos[i] > sp.last_pos) {
+                            sp.acc.assign(embd, embd + n_embd);
+                        }
+                        break;
+                    case LLAMA_POOLING_MEAN:
+                        for (int j = 0; j < n_embd; ++j) {
+                            sp.acc[j] += embd[j];
+                        }
+                        break;
+                    case LLAMA_POOLING_MAX:
+                        for (int j = 0; j < n_embd; ++j) {
+                            sp.acc[j] = std::max(sp.acc[j], embd[j]);
+                        }
+                        break;
+                }
+            }
+
+            sp.n_tokens++;
+            sp.last_pos = std::max(sp.last_pos, pos[i]);
         }
-    }
 
-    // extract embeddings
-    if (lctx.embedding.size()) {
-        auto & embedding_out = lctx.embedding;
+        for (int id : std::set<int>(seq_id, seq_id + N)) {
+            auto & sp = embd_seq[id];
 
-        embedding_out.resize(n_embd);
-        memcpy(embedding_out.data(), (float *) ggml_get_data(embeddings) + (n_embd*(N - 1)), sizeof(float)*n_embd);
+            sp.pooled = sp.acc;
+            if (lctx.pooling == LLAMA_POOLING_MEAN) {
+                const float scale = 1.0f/sp.n_tokens;
+                for (auto & e : sp.pooled) {
+                    e *= scale;
+                }
+            }
+        }
+
+        if (N > 0) {
+            lctx.embedding = embd_seq[seq_id[N - 1]].pooled;
+        }
     }
 
     if (mem_per_token == 0) {
@@ -1071,9 +1473,10 @@ static bool llama_eval_internal(
     ggml_free(ctx0);
 
     // measure the performance only for the single-token evals
-    if (N == 1) {
+    // a batch with one token for each of its sequences (parallel decoding) counts as one eval per sequence
+    if (N == 1 || (int) std::set<int>(seq_id, seq_id + N).size() == N) {
         lctx.t_eval_us += ggml_time_us() - t_start_us;
-        lctx.n_eval++;
+        lctx.n_eval += N;
     }
     else if (N > 1) {
         lctx.t_p_eval_us += ggml_time_us() - t_start_us;
@@ -1252,63 +1655,52 @@ static void sample_top_k(std::vector<std::pair<float, llama_vocab::id>> & logits
     logits_id.resize(top_k);
 }
 
-static llama_vocab::id llama_sample_top_p_top_k(
-        llama_context & lctx,
+// compute the sampling distribution of the top_k/top_p/temp/repeat_penalty sampler
+// plogits[i] is the logit of token ids[i], or of token i if ids is NULL
+// on return, probs[i] is the probability of token logits_id[i].second, sorted by decreasing probability
+static void llama_sample_probs(
+        const float * plogits,
+        const llama_vocab::id * ids,
+        const int n_logits,
         const std::vector<llama_vocab::id> & last_n_tokens,
         int top_k,
         float top_p,
         float temp,
-        float repeat_penalty) {
-    auto & rng = lctx.rng;
-
-    const int n_logits = lctx.model.hparams.n_vocab;
-
-    const auto & logits = lctx.logits;
-    const auto * plogits = logits.data() + logits.size() - n_logits;
-
-    std::vector<std::pair<float, llama_vocab::id>> logits_id;
+        float repeat_penalty,
+        std::vector<std::pair<float, llama_vocab::id>> & logits_id,
+        std::vector<float> & probs) {
+    logits_id.clear();
     logits_id.reserve(n_logits);
 
     {
         const float scale = 1.0f/temp;
         for (int i = 0; i < n_logits; ++i) {
+            const llama_vocab::id id = ids ? ids[i] : i;
+
             // repetition penalty from ctrl paper (https://arxiv.org/abs/1909.05858)
             // credit https://github.com/facebookresearch/llama/compare/main...shawwn:llama:main
-            if (std::find(last_n_tokens.begin(), last_n_tokens.end(), i) != last_n_tokens.end()) {
+            if (std::find(last_n_tokens.begin(), last_n_tokens.end(), id) != last_n_tokens.end()) {
                 // if score < 0 then repetition penalty has to multiplied to reduce the previous token probability
                 if (plogits[i] < 0.0f) {
-                    logits_id.push_back(std::make_pair(plogits[i]*scale*repeat_penalty, i));
+                    logits_id.push_back(std::make_pair(plogits[i]*scale*repeat_penalty, id));
                 } else {
-                    logits_id.push_back(std::make_pair(plogits[i]*scale/repeat_penalty, i));
+                    logits_id.push_back(std::make_pair(plogits[i]*scale/repeat_penalty, id));
                 }
             } else {
-                logits_id.push_back(std::make_pair(plogits[i]*scale, i));
+                logits_id.push_back(std::make_pair(plogits[i]*scale, id));
             }
         }
     }
 
-    sample_top_k(logits_id, top_k);
-
-    float maxl = -std::numeric_limits<float>::infinity();
-    for (const auto & kv : logits_id) {
-        maxl = std::max(maxl, kv.first);
-    }
+    sample_top_k(logits_id, std::min(top_k, n_logits));
 
     // compute probs for the top k tokens
-    std::vector<float> probs;
-    probs.reserve(logits_id.size());
-
-    double sum = 0.0;
-    for (const auto & kv : logits_id) {
-        const float p = expf(kv.first - maxl);
-        probs.push_back(p);
-        sum += p;
+    probs.resize(logits_id.size());
+    for (size_t i = 0; i < logits_id.size(); ++i) {
+        probs[i] = logits_id[i].first;
     }
 
-    // normalize the probs
-    for (auto & p : probs) {
-        p /= sum;
-    }
+    ggml_soft_max_f32_row(probs.data(), probs.data(), (int) probs.size());
 
     if (top_p < 1.0) {
         double cumsum = 0.0;
@@ -1326,6 +1718,29 @@ static llama_vocab::id llama_sample_top_p_top_k(
             probs[i] *= cumsum;
         }
     }
+}
+
+static llama_vocab::id llama_sample_top_p_top_k(
+        llama_context & lctx,
+        const std::vector<llama_vocab::id> & last_n_tokens,
+        int top_k,
+        float top_p,
+        float temp,
+        float repeat_penalty) {
+    auto & rng = lctx.rng;
+
+    const auto & vocab_subset = lctx.vocab_subset;
+
+    const int n_logits = vocab_subset.empty() ? lctx.model.hparams.n_vocab : vocab_subset.size();
+
+    const auto & logits = lctx.logits;
+    const auto * plogits = logits.data() + logits.size() - n_logits;
+
+    std::vector<std::pair<float, llama_vocab::id>> logits_id;
+    std::vector<float> probs;
+
+    llama_sample_probs(plogits, vocab_subset.empty() ? nullptr : vocab_subset.data(), n_logits,
+            last_n_tokens, top_k, top_p, temp, repeat_penalty, logits_id, probs);
 
     //printf("\n");
     //for (int i = 0; i < (int) 10; i++) {
@@ -1340,6 +1755,205 @@ static llama_vocab::id llama_sample_top_p_top_k(
     return logits_id[idx].second;
 }
 
+//
+// speculative decoding
+//
+
+static llama_vocab::id llama_argmax(const float * plogits, int n_logits) {
+    int best = 0;
+    for (int i = 1; i < n_logits; ++i) {
+        if (plogits[i] > plogits[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// dense sampling distribution over the whole vocabulary
+static void llama_sample_probs_dense(
+        const float * plogits,
+        const int n_logits,
+        const std::vector<llama_vocab::id> & last_n_tokens,
+        const llama_speculative_params & params,
+        std::vector<float> & dense) {
+    std::vector<std::pair<float, llama_vocab::id>> logits_id;
+    std::vector<float> probs;
+
+    llama_sample_probs(plogits, nullptr, n_logits, last_n_tokens, params.top_k, params.top_p, params.temp, params.repeat_penalty, logits_id, probs);
+
+    dense.assign(n_logits, 0.0f);
+    for (size_t i = 0; i < probs.size(); ++i) {
+        dense[logits_id[i].second] = probs[i];
+    }
+}
+
+static void llama_push_last_n(std::vector<llama_vocab::id> & last_n_tokens, llama_vocab::id id) {
+    if (!last_n_tokens.empty()) {
+        last_n_tokens.erase(last_n_tokens.begin());
+        last_n_tokens.push_back(id);
+    }
+}
+
+static int llama_speculative_internal(
+        llama_context & ctx_tgt,
+        llama_context & ctx_dft,
+        std::vector<llama_vocab::id> last_n_tokens,
+        llama_vocab::id id,
+        int n_past,
+        const llama_speculative_params & params,
+        llama_vocab::id * out,
+        int n_threads) {
+    const int n_vocab = ctx_tgt.model.hparams.n_vocab;
+    const int n_ctx   = std::min(ctx_tgt.model.hparams.n_ctx, ctx_dft.model.hparams.n_ctx);
+
+    if (ctx_dft.model.hparams.n_vocab != n_vocab) {
+        fprintf(stderr, "%s: the draft and target models have different vocabularies (%d vs %d)\n",
+                __func__, ctx_dft.model.hparams.n_vocab, n_vocab);
+        return -1;
+    }
+
+    if (!ctx_tgt.vocab_subset.empty() || !ctx_dft.vocab_subset.empty()) {
+        fprintf(stderr, "%s: vocabulary subsets are not supported\n", __func__);
+        return -1;
+    }
+
+    const bool greedy = params.temp <= 0.0f;
+
+    // the target evaluates id + n_draft tokens
+    const int n_draft = std::max(0, std::min(params.n_draft, n_ctx - n_past - 1));
+
+    std::vector<llama_vocab::id> draft;
+    std::vector<std::vector<float>> q_dft(greedy ? 0 : n_draft); // draft distributions
+
+    // draft
+    {
+        std::vector<llama_vocab::id> last_n_dft = last_n_tokens;
+
+        llama_vocab::id cur = id;
+        for (int i = 0; i < n_draft; ++i) {
+            if (llama_eval(&ctx_dft, &cur, 1, n_past + i, n_threads)) {
+                return -1;
+            }
+
+            const float * plogits = ctx_dft.logits.data();
+
+            const int64_t t_start_sample_us = ggml_time_us();
+
+            if (greedy) {
+                cur = llama_argmax(plogits, n_vocab);
+            } else {
+                llama_sample_probs_dense(plogits, n_vocab, last_n_dft, params, q_dft[i]);
+
+                std::discrete_distribution<> dist(q_dft[i].begin(), q_dft[i].end());
+                cur = dist(ctx_dft.rng);
+            }
+
+            ctx_dft.t_sample_us += ggml_time_us() - t_start_sample_us;
+            ctx_dft.n_sample++;
+
+            draft.push_back(cur);
+            llama_push_last_n(last_n_dft, cur);
+        }
+    }
+
+    // verify all drafted tokens with a single evaluation of the target
+    {
+        std::vector<llama_vocab::id> tokens(1, id);
+        tokens.insert(tokens.end(), draft.begin(), draft.end());
+
+        const int n_tokens = tokens.size();
+
+        std::vector<int> pos(n_tokens);
+        std::vector<int> seq_id(n_tokens, 0);
+        std::vector<int> out_ids(n_tokens);
+        for (int i = 0; i < n_tokens; ++i) {
+            pos[i]     = n_past + i;
+            out_ids[i] = i;
+        }
+
+        kv_cache_seq_rm(ctx_tgt.model.kv_self, 0, n_past);
+
+        if (!llama_eval_internal(ctx_tgt, tokens.data(), pos.data(), seq_id.data(), n_tokens, n_threads, out_ids)) {
+            return -1;
+        }
+    }
+
+    const int64_t t_start_sample_us = ggml_time_us();
+
+    // accept the longest valid prefix of the draft, followed by one token from the target
+    int n_accept = 0;
+    int n_out    = 0;
+    {
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<float> p_tgt;
+
+        for (int i = 0; i <= n_draft; ++i) {
+            const float * plogits = ctx_tgt.logits.data() + i*n_vocab;
+
+            if (greedy) {
+                const llama_vocab::id t = llama_argmax(plogits, n_vocab);
+
+                out[n_out++] = t;
+                if (i < n_draft && t == draft[i]) {
+                    n_accept++;
+                    continue;
+                }
+                break;
+            }
+
+            llama_sample_probs_dense(plogits, n_vocab, last_n_tokens, params, p_tgt);
+
+            if (i < n_draft) {
+                const llama_vocab::id d = draft[i];
+
+                // accept the draft with probability min(1, p(d)/q(d))
+                if (uniform(ctx_tgt.rng)*q_dft[i][d] <= p_tgt[d]) {
+                    out[n_out++] = d;
+                    n_accept++;
+                    llama_push_last_n(last_n_tokens, d);
+                    continue;
+                }
+
+                // on rejection, sample from the residual distribution max(0, p - q)
+                double sum = 0.0;
+                for (int j = 0; j < n_vocab; ++j) {
+                    p_tgt[j] = std::max(0.0f, p_tgt[j] - q_dft[i][j]);
+                    sum += p_tgt[j];
+                }
+
+                if (sum <= 0.0) {
+                    llama_sample_probs_dense(plogits, n_vocab, last_n_tokens, params, p_tgt);
+                }
+            }
+
+            std::discrete_distribution<> dist(p_tgt.begin(), p_tgt.end());
+            out[n_out++] = dist(ctx_tgt.rng);
+            break;
+        }
+    }
+
+    ctx_tgt.t_sample_us += ggml_time_us() - t_start_sample_us;
+    ctx_tgt.n_sample += n_out;
+
+    ctx_tgt.n_draft  += n_draft;
+    ctx_tgt.n_accept += n_accept;
+
+    // roll back the KV caches to id + the accepted drafts
+    const int n_past_new = n_past + 1 + n_accept;
+
+    kv_cache_seq_rm(ctx_tgt.model.kv_self, 0, n_past_new);
+    kv_cache_seq_rm(ctx_dft.model.kv_self, 0, n_past_new);
+
+    // the draft has not evaluated its last token yet if all of them were accepted
+    if (n_draft > 0 && n_accept == n_draft) {
+        if (llama_eval(&ctx_dft, &draft[n_draft - 1], 1, n_past + n_draft, n_threads)) {
+            return -1;
+        }
+    }
+
+    return n_out;
+}
+
 //
 // quantization
 //
@@ -1351,10 +1965,12 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
     switch (itype) {
         case 2: type = GGML_TYPE_Q4_0; break;
         case 3: type = GGML_TYPE_Q4_1; break;
+        case 5: type = GGML_TYPE_Q5_0; break;
+        case 6: type = GGML_TYPE_Q8_0; break;
         default: fprintf(stderr, "%s: invalid quantization type %d\n", __func__, itype); return 1;
     };
 
-    if (type != GGML_TYPE_Q4_0 && type != GGML_TYPE_Q4_1) {
+    if (type != GGML_TYPE_Q4_0 && type != GGML_TYPE_Q4_1 && type != GGML_TYPE_Q5_0 && type != GGML_TYPE_Q8_0) {
         fprintf(stderr, "%s: invalid quantization type %d\n", __func__, type);
         return false;
     }
@@ -1476,6 +2092,7 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
 
         std::vector<uint8_t>     data_u8;
         std::vector<ggml_fp16_t> data_f16;
+        std::vector<ggml_bf16_t> data_bf16;
         std::vector<float>       data_f32;
 
         std::vector<int64_t> hist_all(1 << 4, 0);
@@ -1504,7 +2121,7 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
             finp.read (&name[0], length);
 
             {
-                static const char * ftype_str[] = { "f32", "f16", "q4_0", "q4_1", };
+                static const char * ftype_str[] = { "f32", "f16", "q4_0", "q4_1", "", "q5_0", "q8_0", "bf16", };
                 printf("%48s - [%5d, %5d], type = %6s ", name.data(), ne[0], ne[1], ftype_str[ftype]);
             }
 
@@ -1525,7 +2142,7 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
             quantize &= (n_dims == 2);
 
             if (quantize) {
-                if (ftype != 0 && ftype != 1) {
+                if (ftype != 0 && ftype != 1 && ftype != 7) {
                     fprintf(stderr, "%s: unsupported ftype %d for integer quantization\n", __func__, ftype);
                     return false;
                 }
@@ -1537,6 +2154,13 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
                     for (int i = 0; i < nelements; ++i) {
                         data_f32[i] = ggml_fp16_to_fp32(data_f16[i]);
                     }
+                } else if (ftype == 7) {
+                    data_bf16.resize(nelements);
+                    finp.read(reinterpret_cast<char *>(data_bf16.data()), nelements * sizeof(ggml_bf16_t));
+                    data_f32.resize(nelements);
+                    for (int i = 0; i < nelements; ++i) {
+                        data_f32[i] = ggml_bf16_to_fp32(data_bf16[i]);
+                    }
                 } else {
                     data_f32.resize(nelements);
                     finp.read(reinterpret_cast<char *>(data_f32.data()), nelements * sizeof(float));
@@ -1574,6 +2198,14 @@ static bool llama_model_quantize_internal(const std::string & fname_inp, const s
                         {
                             cur_size = ggml_quantize_q4_1(data_f32.data(), work.data(), nelements, ne[0], hist_cur.data());
                         } break;
+                    case GGML_TYPE_Q5_0:
+                        {
+                            cur_size = ggml_quantize_q5_0(data_f32.data(), work.data(), nelements, ne[0], hist_cur.data());
+                        } break;
+                    case GGML_TYPE_Q8_0:
+                        {
+                            cur_size = ggml_quantize_q8_0(data_f32.data(), work.data(), nelements, ne[0], hist_cur.data());
+                        } break;
                     default:
                         {
                             fprintf(stderr, "%s: unsupported quantization type %d\n", __func__, type);
@@ -1642,6 +2274,20 @@ struct llama_context * llama_init_from_file(
 
     ctx->rng = std::mt19937(params.seed);
     ctx->logits_all = params.logits_all;
+    ctx->priority   = params.priority;
+
+    if (params.cpus != nullptr) {
+        ctx->cpus.resize(LLAMA_MAX_CPUS);
+
+        const int n_cpus = ggml_cpu_select(params.cpus, ctx->cpus.data(), ctx->cpus.size());
+        if (n_cpus <= 0) {
+            fprintf(stderr, "%s: invalid or unsupported cpu set '%s'\n", __func__, params.cpus);
+            llama_free(ctx);
+            return nullptr;
+        }
+
+        ctx->cpus.resize(n_cpus);
+    }
 
     ggml_type memory_type = params.f16_kv ? GGML_TYPE_F16 : GGML_TYPE_F32;
 
@@ -1653,6 +2299,27 @@ struct llama_context * llama_init_from_file(
         return nullptr;
     }
 
+    const int n_numa_nodes = params.numa && !params.vocab_only ? ggml_numa_init() : 1;
+
+    if (n_numa_nodes > 1) {
+        auto & model = ctx->model;
+
+        fprintf(stderr, "%s: distributing the weights over %d NUMA nodes\n", __func__, n_numa_nodes);
+
+        for (auto & layer : model.layers) {
+            ggml_numa_distribute(layer.wq);
+            ggml_numa_distribute(layer.wk);
+            ggml_numa_distribute(layer.wv);
+            ggml_numa_distribute(layer.wo);
+
+            ggml_numa_distribute(layer.w1);
+            ggml_numa_distribute(layer.w2);
+            ggml_numa_distribute(layer.w3);
+        }
+
+        ggml_numa_distribute(model.output);
+    }
+
     if (params.use_mlock) {
         char *err;
         if (!ggml_mlock(ctx->model.ctx, &err)) {
@@ -1686,10 +2353,13 @@ struct llama_context * llama_init_from_file(
         }
 
         if (params.embedding){
+            ctx->embedding_mode = true;
+            ctx->pooling        = params.pooling;
             ctx->embedding.resize(hparams.n_embd);
         }
 
-        ctx->buf_compute.resize(MEM_REQ_EVAL.at(ctx->model.type));
+        // plus the attention mask of a batch of up to n_ctx tokens (n_kv x N floats)
+        ctx->buf_compute.resize(MEM_REQ_EVAL.at(ctx->model.type) + (size_t) hparams.n_ctx*hparams.n_ctx*sizeof(float));
 
         ctx->buf_scratch[0].resize(MEM_REQ_SCRATCH0.at(ctx->model.type));
         ctx->buf_scratch[1].resize(MEM_REQ_SCRATCH1.at(ctx->model.type));
@@ -1699,6 +2369,21 @@ struct llama_context * llama_init_from_file(
 }
 
 void llama_free(struct llama_context * ctx) {
+    {
+        auto & w = ctx->eval_worker;
+
+        std::unique_lock<std::mutex> lock(w.mutex);
+        w.cv.wait(lock, [&] { return !w.pending && !w.busy; });
+        w.exit = true;
+        w.cv.notify_all();
+    }
+
+    if (ctx->eval_worker.thread.joinable()) {
+        ctx->eval_worker.thread.join();
+    }
+
+    ggml_threadpool_free(ctx->threadpool);
+
     kv_cache_free(ctx->model.kv_self);
 
     if (ctx->model.ctx) {
@@ -1720,13 +2405,280 @@ int llama_model_quantize(
     return 0;
 }
 
+//
+// asynchronous evaluation
+//
+
+static void llama_eval_worker_loop(llama_eval_worker * w) {
+    std::unique_lock<std::mutex> lock(w->mutex);
+
+    while (true) {
+        w->cv.wait(lock, [&] { return w->job || w->exit; });
+
+        if (!w->job) {
+            break;
+        }
+
+        auto job  = std::move(w->job);
+        auto done = std::move(w->done);
+        w->job  = nullptr;
+        w->done = nullptr;
+
+        lock.unlock();
+        const int result = job();
+        lock.lock();
+
+        // the evaluation is over before the callback runs, so that the callback can submit the next one
+        w->result  = result;
+        w->pending = false;
+        w->cv.notify_all();
+
+        if (done) {
+            lock.unlock();
+            done(result);
+            lock.lock();
+        }
+    }
+}
+
+// hand an evaluation to the background thread of the context, starting it on first use
+static int llama_eval_submit(struct llama_context * ctx, std::function<int()> job, std::function<void(int)> done, const char * func) {
+    auto & w = ctx->eval_worker;
+
+    std::lock_guard<std::mutex> lock(w.mutex);
+
+    if (w.pending || w.busy) {
+        fprintf(stderr, "%s: an evaluation is already in flight\n", func);
+        return 1;
+    }
+
+    if (!w.thread.joinable()) {
+        w.thread = std::thread(llama_eval_worker_loop, &w);
+    }
+
+    w.job     = std::move(job);
+    w.done    = std::move(done);
+    w.pending = true;
+    w.cv.notify_all();
+
+    return 0;
+}
+
+// claims the context for a synchronous call until the end of the scope
+// fails if an evaluation (asynchronous or from another thread) is in flight
+struct llama_eval_claim {
+    llama_eval_worker & w;
+    bool ok = false;
+
+    llama_eval_claim(struct llama_context * ctx, const char * func) : w(ctx->eval_worker) {
+        std::lock_guard<std::mutex> lock(w.mutex);
+
+        if (w.pending || w.busy) {
+            fprintf(stderr, "%s: an evaluation is already in flight\n", func);
+            return;
+        }
+
+        w.busy = true;
+        ok     = true;
+    }
+
+    ~llama_eval_claim() {
+        if (ok) {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.busy = false;
+            w.cv.notify_all();
+        }
+    }
+};
+
+// the accessors of the results wait until no evaluation uses the context
+static void llama_eval_idle(struct llama_context * ctx) {
+    auto & w = ctx->eval_worker;
+
+    std::unique_lock<std::mutex> lock(w.mutex);
+    w.cv.wait(lock, [&] { return !w.pending && !w.busy; });
+}
+
+// remove the tokens of sequence seq_id (any sequence if seq_id < 0) with position >= p0 from the KV cache
+// in embedding mode, the pooling of the sequences that lose pooled tokens starts over
+static void llama_seq_rm(struct llama_context * ctx, int seq_id, int p0) {
+    kv_cache_seq_rm(ctx->model.kv_self, seq_id, p0);
+
+    auto & embd_seq = ctx->embedding_seq;
+    for (auto it = embd_seq.begin(); it != embd_seq.end();) {
+        if ((seq_id < 0 || it->first == seq_id) && it->second.last_pos >= p0) {
+            it = embd_seq.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static int llama_eval_tokens(
+        struct llama_context * ctx,
+           const llama_token * tokens,
+                         int   n_tokens,
+                         int   n_past,
+                         int   n_threads) {
+    std::vector<int> pos(n_tokens);
+    std::vector<int> seq_id(n_tokens, 0);
+    for (int i = 0; i < n_tokens; ++i) {
+        pos[i] = n_past + i;
+    }
+
+    std::vector<int> out_ids;
+    if (ctx->logits_all) {
+        out_ids.resize(n_tokens);
+        for (int i = 0; i < n_tokens; ++i) {
+            out_ids[i] = i;
+        }
+    } else if (n_tokens > 0) {
+        out_ids.push_back(n_tokens - 1);
+    }
+
+    // only the first n_past tokens of the sequence are kept
+    llama_seq_rm(ctx, 0, n_past);
+
+    if (!llama_eval_internal(*ctx, tokens, pos.data(), seq_id.data(), n_tokens, n_threads, out_ids)) {
+        fprintf(stderr, "%s: failed to eval\n", __func__);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int llama_decode_batch(
+        struct llama_context * ctx,
+          struct llama_batch   batch,
+                         int   n_threads) {
+    std::vector<int> out_ids;
+    if (batch.logits) {
+        for (int i = 0; i < batch.n_tokens; ++i) {
+            if (batch.logits[i]) {
+                out_ids.push_back(i);
+            }
+        }
+    }
+
+    if (!llama_eval_internal(*ctx, batch.token, batch.pos, batch.seq_id, batch.n_tokens, n_threads, out_ids)) {
+        fprintf(stderr, "%s: failed to decode\n", __func__);
+        return 1;
+    }
+
+    return 0;
+}
+
 int llama_eval(
         struct llama_context * ctx,
            const llama_token * tokens,
                          int   n_tokens,
                          int   n_past,
                          int   n_threads) {
-    if (!llama_eval_internal(*ctx, tokens, n_tokens, n_past, n_threads)) {
+    llama_eval_claim claim(ctx, __func__);
+    if (!claim.ok) {
+        return 1;
+    }
+
+    return llama_eval_tokens(ctx, tokens, n_tokens, n_past, n_threads);
+}
+
+int llama_eval_async(
+        struct llama_context * ctx,
+           const llama_token * tokens,
+                         int   n_tokens,
+                         int   n_past,
+                         int   n_threads,
+         llama_eval_callback   callback,
+                        void * user_data) {
+    std::vector<llama_token> tokens_copy(tokens, tokens + n_tokens);
+
+    std::function<void(int)> done;
+    if (callback) {
+        done = [=](int result) { callback(ctx, result, user_data); };
+    }
+
+    return llama_eval_submit(ctx, [=]() {
+        return llama_eval_tokens(ctx, tokens_copy.data(), n_tokens, n_past, n_threads);
+    }, done, __func__);
+}
+
+int llama_decode_async(
+        struct llama_context * ctx,
+          struct llama_batch   batch,
+                         int   n_threads,
+         llama_eval_callback   callback,
+                        void * user_data) {
+    const int n = batch.n_tokens;
+
+    std::vector<llama_token> token (batch.token,  batch.token  + n);
+    std::vector<int>         pos   (batch.pos,    batch.pos    + n);
+    std::vector<int>         seq_id(batch.seq_id, batch.seq_id + n);
+    std::vector<char>        logits;
+    if (batch.logits) {
+        logits.assign(batch.logits, batch.logits + n);
+    }
+
+    std::function<void(int)> done;
+    if (callback) {
+        done = [=](int result) { callback(ctx, result, user_data); };
+    }
+
+    return llama_eval_submit(ctx, [=]() {
+        const llama_batch batch_copy = {
+            n, token.data(), pos.data(), seq_id.data(), logits.empty() ? NULL : (const bool *) logits.data(),
+        };
+
+        return llama_decode_batch(ctx, batch_copy, n_threads);
+    }, done, __func__);
+}
+
+bool llama_eval_poll(struct llama_context * ctx) {
+    auto & w = ctx->eval_worker;
+
+    std::lock_guard<std::mutex> lock(w.mutex);
+
+    return !w.pending;
+}
+
+int llama_eval_wait(struct llama_context * ctx) {
+    auto & w = ctx->eval_worker;
+
+    std::unique_lock<std::mutex> lock(w.mutex);
+    w.cv.wait(lock, [&] { return !w.pending; });
+
+    return w.result;
+}
+
+int llama_eval_logits(
+        struct llama_context * ctx,
+           const llama_token * tokens,
+                         int   n_tokens,
+                         int   n_past,
+                         int   n_threads,
+                  const bool * logits_mask) {
+    llama_eval_claim claim(ctx, __func__);
+    if (!claim.ok) {
+        return 1;
+    }
+
+    std::vector<int> pos(n_tokens);
+    std::vector<int> seq_id(n_tokens, 0);
+    for (int i = 0; i < n_tokens; ++i) {
+        pos[i] = n_past + i;
+    }
+
+    std::vector<int> out_ids;
+    if (logits_mask) {
+        for (int i = 0; i < n_tokens; ++i) {
+            if (logits_mask[i]) {
+                out_ids.push_back(i);
+            }
+        }
+    }
+
+    llama_seq_rm(ctx, 0, n_past);
+
+    if (!llama_eval_internal(*ctx, tokens, pos.data(), seq_id.data(), n_tokens, n_threads, out_ids)) {
         fprintf(stderr, "%s: failed to eval\n", __func__);
         return 1;
     }
@@ -1734,6 +2686,32 @@ int llama_eval(
     return 0;
 }
 
+int llama_decode(
+        struct llama_context * ctx,
+          struct llama_batch   batch,
+                         int   n_threads) {
+    llama_eval_claim claim(ctx, __func__);
+    if (!claim.ok) {
+        return 1;
+    }
+
+    return llama_decode_batch(ctx, batch, n_threads);
+}
+
+int llama_kv_cache_seq_rm(
+        struct llama_context * ctx,
+                         int   seq_id,
+                         int   p0) {
+    llama_eval_claim claim(ctx, __func__);
+    if (!claim.ok) {
+        return 1;
+    }
+
+    llama_seq_rm(ctx, seq_id, p0);
+
+    return 0;
+}
+
 int llama_tokenize(
         struct llama_context * ctx,
                   const char * text,
@@ -1767,13 +2745,57 @@ int llama_n_embd(struct llama_context * ctx) {
 }
 
 float * llama_get_logits(struct llama_context * ctx) {
+    llama_eval_idle(ctx);
+
+    // the lm_head is skipped in embedding mode
+    if (ctx->embedding_mode) {
+        return nullptr;
+    }
+
     return ctx->logits.data();
 }
 
+int llama_n_logits(struct llama_context * ctx) {
+    const int n_cols = ctx->vocab_subset.empty() ? ctx->model.hparams.n_vocab : ctx->vocab_subset.size();
+
+    return ctx->logits.size()/n_cols;
+}
+
+int llama_set_vocab_subset(
+        struct llama_context * ctx,
+           const llama_token * tokens,
+                         int   n_tokens) {
+    llama_eval_idle(ctx);
+
+    for (int i = 0; i < n_tokens; ++i) {
+        if (tokens[i] < 0 || tokens[i] >= ctx->model.hparams.n_vocab) {
+            fprintf(stderr, "%s: invalid token %d\n", __func__, tokens[i]);
+            return 1;
+        }
+    }
+
+    ctx->vocab_subset.assign(tokens, tokens + (tokens ? n_tokens : 0));
+
+    return 0;
+}
+
 float * llama_get_embeddings(struct llama_context * ctx) {
     return ctx->embedding.data();
 }
 
+float * llama_get_embeddings_seq(struct llama_context * ctx, int seq_id) {
+    auto it = ctx->embedding_seq.find(seq_id);
+    if (it == ctx->embedding_seq.end()) {
+        return nullptr;
+    }
+
+    return it->second.pooled.data();
+}
+
+float * llama_get_token_embeddings(struct llama_context * ctx) {
+    return ctx->embedding_tokens.data();
+}
+
 const char * llama_token_to_str(struct llama_context * ctx, llama_token token) {
     if (token >= llama_n_vocab(ctx)) {
         return nullptr;
@@ -1798,6 +2820,8 @@ llama_token llama_sample_top_p_top_k(
                   float   top_p,
                   float   temp,
                   float   repeat_penalty) {
+    llama_eval_idle(ctx);
+
     const int64_t t_start_sample_us = ggml_time_us();
 
     llama_token result = 0;
@@ -1819,6 +2843,52 @@ llama_token llama_sample_top_p_top_k(
     return result;
 }
 
+struct llama_speculative_params llama_speculative_default_params() {
+    struct llama_speculative_params result = {
+        /*.n_draft        =*/ 4,
+        /*.top_k          =*/ 40,
+        /*.top_p          =*/ 0.95f,
+        /*.temp           =*/ 0.80f,
+        /*.repeat_penalty =*/ 1.10f,
+    };
+
+    return result;
+}
+
+int llama_speculative_step(
+        struct llama_context * ctx_tgt,
+        struct llama_context * ctx_dft,
+           const llama_token * last_n_tokens_data,
+                         int   last_n_tokens_size,
+                 llama_token   id,
+                         int   n_past,
+    struct llama_speculative_params   params,
+                 llama_token * out,
+                         int   n_threads) {
+    llama_eval_claim claim_tgt(ctx_tgt, __func__);
+    if (!claim_tgt.ok) {
+        return -1;
+    }
+
+    llama_eval_claim claim_dft(ctx_dft, __func__);
+    if (!claim_dft.ok) {
+        return -1;
+    }
+
+    const auto last_n_tokens = std::vector<llama_token>(last_n_tokens_data, last_n_tokens_data + last_n_tokens_size);
+
+    const int n_out = llama_speculative_internal(*ctx_tgt, *ctx_dft, last_n_tokens, id, n_past, params, out, n_threads);
+    if (n_out < 0) {
+        fprintf(stderr, "%s: failed to decode\n", __func__);
+    }
+
+    return n_out;
+}
+
+float llama_speculative_acceptance_rate(struct llama_context * ctx_tgt) {
+    return ctx_tgt->n_draft > 0 ? float(ctx_tgt->n_accept)/ctx_tgt->n_draft : 0.0f;
+}
+
 
 void llama_print_timings(struct llama_context * ctx) {
     const int64_t t_end_us = ggml_time_us();
@@ -1832,6 +2902,21 @@ void llama_print_timings(struct llama_context * ctx) {
     fprintf(stderr, "%s:      sample time = %8.2f ms / %5d runs   (%8.2f ms per run)\n",   __func__, 1e-3 * ctx->t_sample_us, n_sample, 1e-3 * ctx->t_sample_us / n_sample);
     fprintf(stderr, "%s: prompt eval time = %8.2f ms / %5d tokens (%8.2f ms per token)\n", __func__, 1e-3 * ctx->t_p_eval_us, n_p_eval, 1e-3 * ctx->t_p_eval_us / n_p_eval);
     fprintf(stderr, "%s:        eval time = %8.2f ms / %5d runs   (%8.2f ms per run)\n",   __func__, 1e-3 * ctx->t_eval_us,   n_eval,   1e-3 * ctx->t_eval_us   / n_eval);
+    if (ctx->n_draft > 0) {
+        fprintf(stderr, "%s:      speculative = %5d drafted, %5d accepted (%6.2f %%)\n", __func__, ctx->n_draft, ctx->n_accept, 100.0*llama_speculative_acceptance_rate(ctx));
+    }
+    if (ctx->threadpool) {
+        ggml_threadpool_stats stats;
+        ggml_threadpool_get_stats(ctx->threadpool, &stats);
+
+        fprintf(stderr, "%s:     thread waits = %8d parked / %8d (%8.2f us avg wake, %8.2f us max)\n", __func__,
+                (int) stats.n_park, (int) stats.n_wait,
+                stats.n_park > 0 ? (double) stats.t_wake_us / stats.n_park : 0.0, (double) stats.t_wake_max_us);
+    }
+    if (ctx->n_queue > 0) {
+        fprintf(stderr, "%s:      queue delay = %8.2f ms / %5d graphs (%8.2f ms avg, %8.2f ms max)\n", __func__,
+                1e-3 * ctx->t_queue_us, ctx->n_queue, 1e-3 * ctx->t_queue_us / ctx->n_queue, 1e-3 * ctx->t_queue_max_us);
+    }
     fprintf(stderr, "%s:       total time = %8.2f ms\n", __func__, (t_end_us - ctx->t_start_us)/1000.0);
 }
 
@@ -1841,6 +2926,14 @@ void llama_reset_timings(struct llama_context * ctx) {
     ctx->t_sample_us = ctx->n_sample = 0;
     ctx->t_eval_us   = ctx->n_eval   = 0;
     ctx->t_p_eval_us = ctx->n_p_eval = 0;
+
+    ctx->n_draft = ctx->n_accept = 0;
+
+    ctx->t_queue_us = ctx->t_queue_max_us = ctx->n_queue = 0;
+
+    if (ctx->threadpool) {
+        ggml_threadpool_reset_stats(ctx->threadpool);
+    }
 }
 
 const char * llama_print_system_info(void) {
@@ -1859,6 +2952,7 @@ const char * llama_print_system_info(void) {
     s += "BLAS = "      + std::to_string(ggml_cpu_has_blas())      + " | ";
     s += "SSE3 = "      + std::to_string(ggml_cpu_has_sse3())      + " | ";
     s += "VSX = "       + std::to_string(ggml_cpu_has_vsx())       + " | ";
+    s += "KERNELS = "   + std::string(ggml_cpu_kernels())          + " | ";
 
     return s.c_str();
 }
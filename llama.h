@@ -47,6 +47,24 @@ extern "C" {
 
     typedef void (*llama_progress_callback)(float progress, void *ctx);
 
+    // How the token embeddings of a sequence are combined in embedding mode
+    enum llama_pooling_type {
+        LLAMA_POOLING_LAST = 0, // embedding of the last token
+        LLAMA_POOLING_MEAN = 1, // mean over all tokens
+        LLAMA_POOLING_MAX  = 2, // element-wise max over all tokens
+    };
+
+    // A batch of tokens for llama_decode()
+    // Every token carries its own position and sequence id, so one batch can advance many independent sequences
+    typedef struct llama_batch {
+        int n_tokens;
+
+        const llama_token * token;
+        const int         * pos;    // position of each token within its sequence, in [0, n_ctx)
+        const int         * seq_id; // sequence of each token, >= 0
+        const bool        * logits; // compute the logits for the tokens where logits[i] is set, NULL for none
+    } llama_batch;
+
     struct llama_context_params {
         int n_ctx;   // text context
         int n_parts; // -1 for default
@@ -56,7 +74,17 @@ extern "C" {
         bool logits_all; // the llama_eval() call computes all logits, not just the last one
         bool vocab_only; // only load the vocabulary, no weights
         bool use_mlock;  // force system to keep model in RAM
-        bool embedding;  // embedding mode only
+        bool numa;       // spread the threads and the weights over the NUMA nodes
+
+        // cpus to pin the compute threads to, NULL for no pinning - see ggml_cpu_select() for the format,
+        // e.g. "0-7", "physical", "l2" or "numa:1"
+        const char * cpus;
+
+        int priority; // graphs of contexts with a higher priority go first on the shared pool
+
+        bool embedding;  // embedding mode only - the lm_head is skipped and no logits are computed
+
+        enum llama_pooling_type pooling; // pooling of the token embeddings in embedding mode
 
         // called with a progress value between 0 and 1, pass NULL to disable
         llama_progress_callback progress_callback;
@@ -76,6 +104,19 @@ extern "C" {
     // Frees all allocated memory
     LLAMA_API void llama_free(struct llama_context * ctx);
 
+    // Shared compute pool
+    // Once initialized, the graphs of all contexts are computed one at a time on a single process-wide pool of
+    // n_threads threads, instead of each context using its own threads - the n_threads argument of the evaluation
+    // calls is then ignored. Waiting graphs go by the priority of their context, then decoding (small batches) goes
+    // ahead of prompt processing, then first come first served. The time spent waiting is reported by
+    // llama_print_timings()
+    // cpus: see llama_context_params.cpus (NULL - no pinning)
+    // Returns 0 on success
+    LLAMA_API int llama_init_shared_pool(int n_threads, const char * cpus);
+
+    // Waits for the graphs that are queued or running, then stops the shared pool
+    LLAMA_API void llama_free_shared_pool(void);
+
     // TODO: not great API - very likely to change
     // Returns 0 on success
     LLAMA_API int llama_model_quantize(
@@ -94,6 +135,75 @@ extern "C" {
                              int   n_past,
                              int   n_threads);
 
+    // Same as llama_eval(), but computes the logits only for the tokens with logits_mask[i] set.
+    // The lm_head runs only over the selected positions, so prompt processing can skip it entirely
+    // Pass NULL as logits_mask to compute no logits at all (e.g. when only filling the KV cache)
+    // The logits_all context parameter is ignored
+    // Returns 0 on success
+    LLAMA_API int llama_eval_logits(
+            struct llama_context * ctx,
+               const llama_token * tokens,
+                             int   n_tokens,
+                             int   n_past,
+                             int   n_threads,
+                      const bool * logits_mask);
+
+    // Evaluate a batch of tokens that can belong to different sequences.
+    // The weight matmuls run once over the whole batch, while each token attends only to the tokens of
+    // its own sequence (cached or in the same batch) with a position not greater than its own.
+    // All sequences share the n_ctx cells of the KV cache; use llama_kv_cache_seq_rm() to free them
+    // llama_eval() is equivalent to a batch of sequence 0 at positions n_past, n_past + 1, ...
+    // Returns 0 on success, 1 on failure (e.g. not enough free space in the KV cache, or an invalid pos or seq_id)
+    LLAMA_API int llama_decode(
+            struct llama_context * ctx,
+              struct llama_batch   batch,
+                             int   n_threads);
+
+    // Called on the background thread of the context when an asynchronous evaluation is done,
+    // with the value the synchronous call would have returned. The evaluation is already over when it runs:
+    // the results (llama_get_logits() etc.) can be read, and the next evaluation can be submitted with
+    // llama_eval_async() / llama_decode_async() (read the results first - the accessors wait for it)
+    // The callback must not call llama_free() on the context
+    typedef void (*llama_eval_callback)(struct llama_context * ctx, int result, void * user_data);
+
+    // Asynchronous versions of llama_eval() and llama_decode(): the evaluation runs on a background thread of the
+    // context (which also drives its compute threads), and the call returns right away. The input is copied.
+    // At most one evaluation can be in flight per context - until llama_eval_poll() returns true or
+    // llama_eval_wait() returns, the evaluation calls, llama_speculative_step() and llama_kv_cache_seq_rm() fail,
+    // and llama_get_logits(), llama_set_vocab_subset() and llama_sample_top_p_top_k() wait for it
+    // The same holds while a synchronous evaluation runs on another thread
+    // Returns 0 if the evaluation was submitted, 1 if one is already in flight
+    LLAMA_API int llama_eval_async(
+            struct llama_context * ctx,
+               const llama_token * tokens,
+                             int   n_tokens,
+                             int   n_past,
+                             int   n_threads,
+             llama_eval_callback   callback,
+                            void * user_data);
+
+    LLAMA_API int llama_decode_async(
+            struct llama_context * ctx,
+              struct llama_batch   batch,
+                             int   n_threads,
+             llama_eval_callback   callback,
+                            void * user_data);
+
+    // Returns true if no asynchronous evaluation is in flight
+    LLAMA_API bool llama_eval_poll(struct llama_context * ctx);
+
+    // Waits until the asynchronous evaluation in flight (if any) is done
+    // Returns the result of the last asynchronous evaluation
+    LLAMA_API int llama_eval_wait(struct llama_context * ctx);
+
+    // Remove the tokens of sequence seq_id with position >= p0 from the KV cache
+    // seq_id < 0 matches any sequence
+    // Returns 0 on success, 1 if an asynchronous evaluation of the context is in flight
+    LLAMA_API int llama_kv_cache_seq_rm(
+            struct llama_context * ctx,
+                             int   seq_id,
+                             int   p0);
+
     // Convert the provided text into tokens.
     // The tokens pointer must be large enough to hold the resulting tokens.
     // Returns the number of tokens on success, no more than n_max_tokens
@@ -113,14 +223,41 @@ extern "C" {
     // Token logits obtained from the last call to llama_eval()
     // The logits for the last token are stored in the last row
     // Can be mutated in order to change the probabilities of the next token
-    // Rows: n_tokens
-    // Cols: n_vocab
+    // Rows: llama_n_logits() - one per token for which logits were computed, in batch order
+    // Cols: n_vocab (or the size of the vocabulary subset, see llama_set_vocab_subset())
+    // Returns NULL in embedding mode, where no logits are computed
     LLAMA_API float * llama_get_logits(struct llama_context * ctx);
 
-    // Get the embeddings for the input
+    // Number of rows in llama_get_logits()
+    LLAMA_API int llama_n_logits(struct llama_context * ctx);
+
+    // Compute the logits of the following evaluations only for the given tokens (e.g. the labels of a classifier).
+    // Only the matching rows of the lm_head are used, and the rows of llama_get_logits() have n_tokens columns
+    // in the order of tokens. llama_sample_top_p_top_k() then samples among these tokens only
+    // Pass NULL to compute the logits for the whole vocabulary again
+    // Returns 0 on success
+    LLAMA_API int llama_set_vocab_subset(
+            struct llama_context * ctx,
+               const llama_token * tokens,
+                             int   n_tokens);
+
+    // Get the embeddings for the input (embedding mode only)
+    // Pooled embeddings of the sequence of the last token of the last evaluation (see llama_get_embeddings_seq())
     // shape: [n_embd] (1-dimensional)
     LLAMA_API float * llama_get_embeddings(struct llama_context * ctx);
 
+    // Pooled embeddings of sequence seq_id, NULL if it has no tokens
+    // The pooling covers all the tokens of the sequence evaluated since its tokens were last removed with
+    // llama_kv_cache_seq_rm(), so a sequence can be evaluated over several batches. Removing any of its
+    // tokens starts the pooling of the sequence over
+    // shape: [n_embd] (1-dimensional)
+    LLAMA_API float * llama_get_embeddings_seq(struct llama_context * ctx, int seq_id);
+
+    // Per-token embeddings (final normalized hidden states) of the last evaluation, before pooling
+    // Rows: n_tokens
+    // Cols: n_embd
+    LLAMA_API float * llama_get_token_embeddings(struct llama_context * ctx);
+
     // Token Id -> String. Uses the vocabulary in the provided context
     LLAMA_API const char * llama_token_to_str(struct llama_context * ctx, llama_token token);
 
@@ -138,6 +275,39 @@ extern "C" {
                       float   temp,
                       float   repeat_penalty);
 
+    // Speculative decoding: a small draft model proposes n_draft tokens that the target model verifies in one batch
+    struct llama_speculative_params {
+        int   n_draft;        // number of tokens proposed by the draft model per step
+        int   top_k;
+        float top_p;
+        float temp;           // <= 0.0f for greedy decoding
+        float repeat_penalty; // ignored in greedy mode
+    };
+
+    LLAMA_API struct llama_speculative_params llama_speculative_default_params();
+
+    // Run one step of speculative decoding. The draft model must use the same vocabulary as the target.
+    // Both contexts must hold the same first n_past tokens and id is the last accepted token, not evaluated yet.
+    // last_n_tokens is the repeat penalty window, ending with id.
+    // Drafted tokens are accepted while they match the target argmax (greedy), or by rejection sampling so that
+    // the output follows the target distribution exactly (temp > 0). The KV caches of both contexts are rolled
+    // back to the accepted tokens.
+    // Writes between 1 and n_draft + 1 tokens to out; the next step continues with id = out[n - 1] and n_past + n
+    // Returns the number of tokens written, negative on failure (or if an evaluation of either context is in flight)
+    LLAMA_API int llama_speculative_step(
+            struct llama_context * ctx_tgt,
+            struct llama_context * ctx_dft,
+               const llama_token * last_n_tokens_data,
+                             int   last_n_tokens_size,
+                     llama_token   id,
+                             int   n_past,
+      struct llama_speculative_params   params,
+                     llama_token * out,
+                             int   n_threads);
+
+    // Fraction of the drafted tokens that were accepted by the target context so far
+    LLAMA_API float llama_speculative_acceptance_rate(struct llama_context * ctx_tgt);
+
     // Performance information
     LLAMA_API void llama_print_timings(struct llama_context * ctx);
     LLAMA_API void llama_reset_timings(struct llama_context * ctx);
@@ -6,7 +6,7 @@
 int main(void) {
     #define QK 32
     float src[QK];
-    uint8_t dst[24];
+    uint8_t dst[36];
     int64_t hist[16];
 
     for (int i = 0; i < QK; i++) {
@@ -38,5 +38,28 @@ int main(void) {
         assert(q4_result == q4_expected);
     }
 
+    size = ggml_quantize_q5_0(src, dst, QK, QK, hist);
+    assert(size == 24);
+    float d_result = ((float *)dst)[0];
+    float d_expected = src[31] / -(1 << 4);
+    assert(d_result == d_expected);
+    uint32_t qh = dst[4] | (dst[5] << 8) | (dst[6] << 16) | ((uint32_t) dst[7] << 24);
+    for (int i = 0; i < QK; i++) {
+        uint8_t q5_result = ((i % 2) ? (dst[sizeof(float) + 4 + i/2] >> 4) : (dst[sizeof(float) + 4 + i/2] & 0xF)) | (((qh >> i) & 1) << 4);
+        uint8_t q5_expected = (uint8_t) (src[i] / d_expected + 16.5f);
+        assert(q5_result == q5_expected);
+    }
+
+    size = ggml_quantize_q8_0(src, dst, QK, QK, hist);
+    assert(size == 36);
+    d_result = ((float *)dst)[0];
+    d_expected = src[31] / ((1 << 7) - 1);
+    assert(d_result == d_expected);
+    for (int i = 0; i < QK; i++) {
+        int8_t q8_result = (int8_t) dst[sizeof(float) + i];
+        int8_t q8_expected = roundf(src[i] / d_expected);
+        assert(q8_result == q8_expected);
+    }
+
     return 0;
 }
@@ -0,0 +1,186 @@
+#include "ggml.h"
+#undef NDEBUG
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QK 32
+
+// check the quantized and bf16 mul_mat kernels (vec_dot, gemm tiles, AVX-512/AVX-VNNI/AVX512-BF16 paths) against a scalar reference
+// with every build of the kernels the CPU supports (one without GGML_DISPATCH) and a few thread counts
+// the activations are integers with a maximum of 127 in each block, so that quantizing them to 8 bits is exact
+
+static float frand(void) {
+    return (float) rand()/(float) RAND_MAX - 0.5f;
+}
+
+// the dequantized value of the quant l of block i of a row of the given type
+static float dequantize_ref(enum ggml_type type, const uint8_t * row, int i, int l) {
+    switch (type) {
+        case GGML_TYPE_Q4_0:
+            {
+                const uint8_t * b = row + i*(sizeof(float) + QK/2);
+                float d; memcpy(&d, b, sizeof(d));
+                const uint8_t v = b[sizeof(float) + l/2];
+                return d*((int) ((l % 2) ? v >> 4 : v & 0xF) - 8);
+            }
+        case GGML_TYPE_Q4_1:
+            {
+                const uint8_t * b = row + i*(2*sizeof(float) + QK/2);
+                float d; memcpy(&d, b, sizeof(d));
+                float m; memcpy(&m, b + sizeof(float), sizeof(m));
+                const uint8_t v = b[2*sizeof(float) + l/2];
+                return d*((l % 2) ? v >> 4 : v & 0xF) + m;
+            }
+        case GGML_TYPE_Q5_0:
+            {
+                const uint8_t * b = row + i*(sizeof(float) + sizeof(uint32_t) + QK/2);
+                float d; memcpy(&d, b, sizeof(d));
+                uint32_t qh; memcpy(&qh, b + sizeof(float), sizeof(qh));
+                const uint8_t v = b[sizeof(float) + sizeof(uint32_t) + l/2];
+                return d*((int) (((l % 2) ? v >> 4 : v & 0xF) | (((qh >> l) & 1) << 4)) - 16);
+            }
+        case GGML_TYPE_Q8_0:
+            {
+                const uint8_t * b = row + i*(sizeof(float) + QK);
+                float d; memcpy(&d, b, sizeof(d));
+                return d*(int8_t) b[sizeof(float) + l];
+            }
+        case GGML_TYPE_BF16:
+            {
+                ggml_bf16_t h; memcpy(&h, row + (i*QK + l)*sizeof(h), sizeof(h));
+                return ggml_bf16_to_fp32(h);
+            }
+        default:
+            assert(false);
+    }
+
+    return 0.0f;
+}
+
+static size_t quantize(enum ggml_type type, const float * src, void * dst, int n, int k) {
+    int64_t hist[16];
+
+    switch (type) {
+        case GGML_TYPE_Q4_0: return ggml_quantize_q4_0(src, dst, n, k, hist);
+        case GGML_TYPE_Q4_1: return ggml_quantize_q4_1(src, dst, n, k, hist);
+        case GGML_TYPE_Q5_0: return ggml_quantize_q5_0(src, dst, n, k, hist);
+        case GGML_TYPE_Q8_0: return ggml_quantize_q8_0(src, dst, n, k, hist);
+        case GGML_TYPE_BF16:
+            for (int i = 0; i < n; i++) {
+                ((ggml_bf16_t *) dst)[i] = ggml_fp32_to_bf16(src[i]);
+            }
+            return n*sizeof(ggml_bf16_t);
+        default: assert(false);
+    }
+
+    return 0;
+}
+
+// the thread counts each product is computed with
+static const int n_threads_list[] = { 1, 3, 8 };
+
+static void test_mul_mat(struct ggml_context * ctx, enum ggml_type type, int ne00, int ne01, int ne11) {
+    struct ggml_tensor * a = ggml_new_tensor_2d(ctx, type,           ne00, ne01);
+    struct ggml_tensor * b = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, ne00, ne11);
+
+    float * x = malloc(sizeof(float)*ne00*ne01);
+    for (int i = 0; i < ne00*ne01; i++) {
+        x[i] = frand();
+    }
+    quantize(type, x, a->data, ne00*ne01, ne00);
+    free(x);
+
+    float * y = (float *) b->data;
+    for (int i = 0; i < ne00*ne11; i++) {
+        y[i] = (i % QK == 0) ? ((rand() % 2) ? 127.0f : -127.0f) : (float) (rand() % 255 - 127);
+    }
+
+    // the reference result and its tolerance
+    double * ref = malloc(sizeof(double)*ne01*ne11);
+    double * tol = malloc(sizeof(double)*ne01*ne11);
+
+    const size_t row_size = ggml_nbytes(a)/ne01;
+
+    for (int i1 = 0; i1 < ne11; i1++) {
+        for (int i0 = 0; i0 < ne01; i0++) {
+            const uint8_t * row = (const uint8_t *) a->data + i0*row_size;
+
+            double sum  = 0.0;
+            double asum = 0.0;
+            for (int k = 0; k < ne00; k++) {
+                const double p = (double) dequantize_ref(type, row, k/QK, k%QK)*(double) y[i1*ne00 + k];
+                sum  += p;
+                asum += fabs(p);
+            }
+
+            ref[i1*ne01 + i0] = sum;
+            tol[i1*ne01 + i0] = 1e-5*asum + 1e-3;
+        }
+    }
+
+    struct ggml_tensor * c = ggml_mul_mat(ctx, a, b);
+
+    // with every build of the kernels the CPU supports
+    const char * kernels;
+    for (int ik = 0; (kernels = ggml_cpu_kernels_supported(ik)) != NULL; ik++) {
+        const bool ok = ggml_cpu_kernels_set(kernels);
+        assert(ok);
+
+        for (size_t t = 0; t < sizeof(n_threads_list)/sizeof(n_threads_list[0]); t++) {
+            const int n_threads = n_threads_list[t];
+
+            for (int i = 0; i < ne01*ne11; i++) {
+                ((float *) c->data)[i] = NAN;
+            }
+
+            struct ggml_cgraph gf = ggml_build_forward(c);
+            gf.n_threads = n_threads;
+
+            ggml_graph_compute(ctx, &gf);
+
+            for (int i = 0; i < ne01*ne11; i++) {
+                const double result = ((float *) c->data)[i];
+                if (!(fabs(result - ref[i]) <= tol[i])) {
+                    fprintf(stderr, "%s kernels, %d threads, type %d, %d x %d x %d: dst[%d, %d] = %f, expected %f\n",
+                            kernels, n_threads, type, ne00, ne01, ne11, i % ne01, i / ne01, result, ref[i]);
+                    assert(false);
+                }
+            }
+        }
+    }
+
+    free(ref);
+    free(tol);
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        .mem_size   = 64*1024*1024,
+        .mem_buffer = NULL,
+    };
+
+    // the first ggml_init() picks the kernels, so that ggml_cpu_kernels_set() can replace them after it
+    ggml_free(ggml_init(params));
+
+    const enum ggml_type types[] = { GGML_TYPE_Q4_0, GGML_TYPE_Q4_1, GGML_TYPE_Q5_0, GGML_TYPE_Q8_0, GGML_TYPE_BF16 };
+
+    for (size_t t = 0; t < sizeof(types)/sizeof(types[0]); t++) {
+        // an odd number of blocks, a single column (vec_dot) and a few columns (gemm tiles or sgemm, and the remainder)
+        // the last one is large enough for BLAS, with partial tiles of rows and values
+        const int shapes[][3] = { { 13*QK, 7, 1 }, { 13*QK, 8, 5 }, { 8*QK, 16, 9 }, { 41*QK, 1100, 33 } };
+
+        for (size_t s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+            struct ggml_context * ctx = ggml_init(params);
+
+            test_mul_mat(ctx, types[t], shapes[s][0], shapes[s][1], shapes[s][2]);
+
+            ggml_free(ctx);
+        }
+    }
+
+    return 0;
+}